@@ -0,0 +1,152 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <ostream>
+#include <regex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "benchcore/flags.hpp"
+#include "benchcore/process.hpp"
+#include "benchcore/sweep.hpp"
+
+namespace benchcore {
+
+// Batched publishing: the source, and where the transport allows it the
+// relays, coalesce messages and send up to --batch-size of them at once.
+// Pending messages are flushed when the batch is full, and every --flush-us.
+struct BatchConfig {
+  size_t size = 1;
+  std::chrono::microseconds flush_interval{1000};
+  // Whether --batch-size was given, even as 1, so the sink reports throughput
+  // to compare against.
+  bool requested = false;
+
+  static BatchConfig from_flags(const Flags& flags) {
+    BatchConfig config;
+    config.size = std::max<int64_t>(1, flags.get_int("batch-size", 1));
+    config.flush_interval = std::chrono::microseconds(flags.get_int("flush-us", 1000));
+    config.requested = flags.has("batch-size");
+    return config;
+  }
+  bool enabled() const { return size > 1; }
+};
+
+// Collects messages until there's a batch to send.
+template <typename T>
+class Batcher {
+ public:
+  explicit Batcher(size_t size) : size_(size) {}
+
+  // Adds a message. Returns true when the batch is full and should be sent.
+  bool add(T message) {
+    pending_.push_back(std::move(message));
+    return pending_.size() >= size_;
+  }
+  bool empty() const { return pending_.empty(); }
+  std::vector<T> take() {
+    std::vector<T> batch;
+    batch.swap(pending_);
+    pending_.reserve(size_);
+    return batch;
+  }
+
+ private:
+  size_t size_;
+  std::vector<T> pending_;
+};
+
+// Messages per second at the sink, from the first message to the last.
+class Throughput {
+ public:
+  void add(int64_t messages, int64_t now_ns) {
+    if (messages_ == 0) {
+      first_ns_ = now_ns;
+    }
+    messages_ += messages;
+    batches_++;
+    last_ns_ = now_ns;
+  }
+
+  void print(std::ostream& out) const {
+    double seconds = (last_ns_ - first_ns_) / 1e9;
+    out << "Throughput: " << static_cast<int64_t>(seconds > 0 ? messages_ / seconds : 0)
+        << " msg/s, " << messages_ << " messages in " << batches_ << " batches\n\n";
+  }
+
+ private:
+  int64_t messages_ = 0;
+  int64_t batches_ = 0;
+  int64_t first_ns_ = 0;
+  int64_t last_ns_ = 0;
+};
+
+// The client side of a batched RPC chain. Makes `count` messages with
+// make(i), one per `period`, and calls send() with each batch when it's full
+// and every flush interval. Timestamps taken in make() include the time a
+// message waits for its batch.
+template <typename T>
+void run_batched_source(const BatchConfig& config, std::chrono::nanoseconds period, int count,
+                        const std::function<T(int)>& make,
+                        const std::function<void(std::vector<T>)>& send) {
+  Batcher<T> batcher(config.size);
+  auto now = std::chrono::steady_clock::now();
+  auto next_message = now;
+  auto next_flush = now + config.flush_interval;
+  int made = 0;
+  while (made < count) {
+    std::this_thread::sleep_until(std::min(next_message, next_flush));
+    now = std::chrono::steady_clock::now();
+    if (now >= next_message) {
+      if (batcher.add(make(made++))) {
+        send(batcher.take());
+      }
+      next_message += period;
+    }
+    if (now >= next_flush) {
+      if (!batcher.empty()) {
+        send(batcher.take());
+      }
+      next_flush += config.flush_interval;
+    }
+  }
+  if (!batcher.empty()) {
+    send(batcher.take());
+  }
+}
+
+// Runs this binary once per batch size in --batch-sweep=1,8,64 and flush
+// interval in --flush-sweep-us=1000, and prints per-message latency and
+// throughput of each as a table.
+inline int run_batch_sweep(const Flags& flags) {
+  std::vector<SweepCase> cases;
+  std::vector<std::vector<std::string>> rows;
+  for (const std::string& size : split(flags.get("batch-sweep"))) {
+    for (const std::string& flush : split(flags.get("flush-sweep-us", "1000"))) {
+      cases.push_back({"with batches of " + size + ", flush every " + flush + "us",
+                       {"--batch-size=" + size, "--flush-us=" + flush}});
+      rows.push_back({size, flush});
+    }
+  }
+  std::vector<SweepRun> runs =
+      run_sweep(flags, {"--batch-", "--flush-"}, cases, std::chrono::seconds(300));
+
+  static const std::regex throughput_re("Throughput: (\\d+) msg/s");
+  for (size_t i = 0; i < runs.size(); ++i) {
+    rows[i].insert(rows[i].end(), {runs[i].stats.p50_cell(), runs[i].stats.p90_cell(),
+                                   find_in_output(runs[i].process, throughput_re)});
+  }
+  print_sweep_table(std::cout, "Batch sweep:",
+                    {"Batch size", "Flush (us)", "P50 (us/hop)", "P90 (us/hop)",
+                     "Throughput (msg/s)"},
+                    rows);
+  return 0;
+}
+
+}  // namespace benchcore
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <ostream>
+#include <regex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchcore/flags.hpp"
+#include "benchcore/process.hpp"
+#include "benchcore/report.hpp"
+#include "benchcore/sweep.hpp"
+
+namespace benchcore {
+
+// Mixed criticality: a bulk chain through the same relays and transport as
+// the measured one, like a camera stream next to control messages.
+//   --bulk-size=N                       bytes per bulk message, no bulk chain
+//                                       without it
+//   --bulk-rate-hz=30                   bulk messages per second
+//   --bulk-isolation=shared|isolated    whether the bulk chain shares the
+//                                       measured chain's queues, or is kept
+//                                       apart with the framework's own means
+// Bulk messages carry negative msgids, which is how relays and sinks tell
+// them from the measured ones.
+struct BulkConfig {
+  int64_t size = 0;
+  std::chrono::nanoseconds period{0};
+  bool isolated = false;
+
+  static BulkConfig from_flags(const Flags& flags) {
+    BulkConfig config;
+    config.size = flags.get_int("bulk-size", 0);
+    config.period = std::chrono::nanoseconds(
+        static_cast<int64_t>(1e9 / flags.get_double("bulk-rate-hz", 30)));
+    std::string isolation = flags.get("bulk-isolation", "shared");
+    if (isolation == "isolated") {
+      config.isolated = true;
+    } else if (isolation != "shared") {
+      throw std::invalid_argument("unknown bulk isolation: " + isolation);
+    }
+    return config;
+  }
+  bool enabled() const { return size > 0; }
+};
+
+inline bool is_bulk(int64_t msgid) { return msgid < 0; }
+
+// Per-hop latency of the bulk messages at the sink. Deliveries may overlap
+// with each other and with the measured chain's. Registers a report section.
+class BulkStats {
+ public:
+  BulkStats(const BulkConfig& config, int num_relays)
+      : config_(config), num_relays_(num_relays) {
+    add_report_section([this](std::ostream& out) { print(out); });
+  }
+
+  void add(int64_t sent_ns, int64_t arrived_ns) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    samples_.push_back((arrived_ns - sent_ns) / (num_relays_ + 1));
+  }
+
+  void print(std::ostream& out) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    out << "Bulk: " << samples_.size() << " messages of " << config_.size << " bytes, "
+        << (config_.isolated ? "isolated" : "shared");
+    if (!samples_.empty()) {
+      std::vector<int64_t> sorted = samples_;
+      std::sort(sorted.begin(), sorted.end());
+      out << ", P50 " << sorted[sorted.size() / 2] / 1000 << "us, P90 "
+          << sorted[sorted.size() * 9 / 10] / 1000 << "us per hop";
+    }
+    out << "\n\n";
+  }
+
+ private:
+  BulkConfig config_;
+  int num_relays_;
+  std::mutex mutex_;
+  std::vector<int64_t> samples_;
+};
+
+// Calls send(msgid, payload) from a thread every config.period, with msgids
+// -1, -2, ... and a payload of config.size bytes, until destroyed. A send
+// that takes longer than the period delays the next one.
+class BulkSource {
+ public:
+  BulkSource(const BulkConfig& config,
+             std::function<void(int64_t msgid, const std::string& payload)> send)
+      : thread_([this, config, send]() {
+          std::string payload(config.size, 'b');
+          auto next = std::chrono::steady_clock::now();
+          for (int64_t msgid = -1; !done_; --msgid) {
+            send(msgid, payload);
+            next += config.period;
+            std::this_thread::sleep_until(next);
+          }
+        }) {}
+  ~BulkSource() {
+    done_ = true;
+    thread_.join();
+  }
+
+ private:
+  std::atomic<bool> done_{false};
+  std::thread thread_;
+};
+
+// With --bulk-sweep, runs this binary without a bulk chain, then with one of
+// --bulk-size (1MB by default) shared and isolated, and prints how much the
+// measured chain's latency inflates in each.
+inline int run_bulk_sweep(const Flags& flags) {
+  std::string size = std::to_string(flags.get_int("bulk-size", 1 << 20));
+  std::vector<std::string> isolations = {"none", "shared", "isolated"};
+  std::vector<SweepCase> cases;
+  for (const std::string& isolation : isolations) {
+    SweepCase sweep_case{"with bulk " + isolation, {}};
+    if (isolation != "none") {
+      sweep_case.args = {"--bulk-size=" + size, "--bulk-isolation=" + isolation};
+    }
+    cases.push_back(std::move(sweep_case));
+  }
+  std::vector<SweepRun> runs = run_sweep(
+      flags, {"--bulk-sweep", "--bulk-size", "--bulk-isolation"}, cases, std::chrono::seconds(300));
+
+  static const std::regex bulk_re("Bulk: (\\d+) messages");
+  const LatencyStats& alone = runs[0].stats;
+  std::vector<std::vector<std::string>> rows;
+  for (size_t i = 0; i < runs.size(); ++i) {
+    const LatencyStats& stats = runs[i].stats;
+    std::string inflation = "-";
+    if (stats.ok() && alone.ok() && alone.p90_us > 0) {
+      std::ostringstream out;
+      out.precision(2);
+      out << std::fixed << static_cast<double>(stats.p90_us) / alone.p90_us << "x";
+      inflation = out.str();
+    }
+    rows.push_back({isolations[i], stats.p50_cell(), stats.p90_cell(), inflation,
+                    find_in_output(runs[i].process, bulk_re)});
+  }
+  print_sweep_table(std::cout, "Bulk sweep, " + size + " byte bulk messages:",
+                    {"Bulk", "P50 (us/hop)", "P90 (us/hop)", "P90 vs. none", "Bulk delivered"},
+                    rows);
+  return 0;
+}
+
+}  // namespace benchcore
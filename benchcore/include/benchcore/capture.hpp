@@ -0,0 +1,189 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include "benchcore/flags.hpp"
+
+namespace benchcore {
+
+// A capture file: a CaptureHeader, then a ring of `capacity` records of
+// `record_size` bytes. Each record is a CaptureRecord followed by `stamps`
+// int64 per-hop timestamps, e.g. pnode's --trace-hops stamps. Those are in
+// the clock of whatever took them, system_clock for pnode, which need not be
+// the benchmark clock of sent_ns and arrived_ns. Only compare them with each
+// other.
+struct CaptureHeader {
+  static constexpr char kMagic[8] = "BCAPT01";
+
+  char magic[8];
+  uint32_t record_size;
+  uint32_t stamps;
+  uint64_t capacity;
+  // Records written so far. The ring holds the last min(written, capacity)
+  // of them, record n at index n % capacity.
+  uint64_t written;
+  uint32_t num_relays;
+  uint32_t reserved[7];
+};
+static_assert(sizeof(CaptureHeader) == 64, "the header is one cache line");
+
+// One message at the sink. sent_ns and arrived_ns are in the benchmark's
+// clock (see clock.hpp), tid and cpu are the receiving thread and the CPU
+// it was running on.
+struct CaptureRecord {
+  int64_t msgid;
+  int64_t sent_ns;
+  int64_t arrived_ns;
+  int32_t tid;
+  int32_t cpu;
+};
+
+// Writes the sink's messages to --capture=FILE, through a ring of
+// --capture-records (default 1M) records mapped from the file. The file is
+// allocated and the mapping populated up front, so add() only stores to
+// memory: no allocation, syscall or page fault. The file is complete even
+// when the process exits without unmapping it. add() may be called from
+// several threads at once.
+class CaptureWriter {
+ public:
+  // Returns nullptr without --capture. `stamps` is the number of per-hop
+  // timestamps each add() passes.
+  static std::unique_ptr<CaptureWriter> from_flags(const Flags& flags, int num_relays,
+                                                   int stamps = 0) {
+    if (!flags.has("capture")) {
+      return nullptr;
+    }
+    int64_t capacity = flags.get_int("capture-records", 1 << 20);
+    if (capacity <= 0) {
+      throw std::invalid_argument("--capture-records must be at least 1");
+    }
+    return std::make_unique<CaptureWriter>(flags.get("capture"), capacity, num_relays, stamps);
+  }
+
+  CaptureWriter(const std::string& path, uint64_t capacity, int num_relays, int stamps)
+      : record_size_(sizeof(CaptureRecord) + stamps * sizeof(int64_t)),
+        stamps_(stamps),
+        capacity_(capacity) {
+    size_ = sizeof(CaptureHeader) + capacity_ * record_size_;
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+      throw std::runtime_error("can't create " + path + ": " + strerror(errno));
+    }
+    int error = posix_fallocate(fd, 0, size_);
+    if (error != 0) {
+      close(fd);
+      throw std::runtime_error("can't allocate " + path + ": " + strerror(error));
+    }
+    void* data = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+      throw std::runtime_error("can't map " + path + ": " + strerror(errno));
+    }
+    data_ = static_cast<char*>(data);
+    header_ = reinterpret_cast<CaptureHeader*>(data_);
+    memcpy(header_->magic, CaptureHeader::kMagic, sizeof(header_->magic));
+    header_->record_size = record_size_;
+    header_->stamps = stamps_;
+    header_->capacity = capacity_;
+    header_->written = 0;
+    header_->num_relays = num_relays;
+  }
+  ~CaptureWriter() { munmap(data_, size_); }
+
+  CaptureWriter(const CaptureWriter&) = delete;
+  CaptureWriter& operator=(const CaptureWriter&) = delete;
+
+  // `stamps` points to the per-hop timestamps, or is nullptr for zeros.
+  void add(int64_t msgid, int64_t sent_ns, int64_t arrived_ns, const int64_t* stamps = nullptr) {
+    thread_local int32_t tid = syscall(SYS_gettid);
+    uint64_t n = __atomic_fetch_add(&header_->written, 1, __ATOMIC_RELAXED);
+    char* slot = data_ + sizeof(CaptureHeader) + (n % capacity_) * record_size_;
+    CaptureRecord record{msgid, sent_ns, arrived_ns, tid, sched_getcpu()};
+    memcpy(slot, &record, sizeof(record));
+    if (stamps_ > 0) {
+      if (stamps) {
+        memcpy(slot + sizeof(record), stamps, stamps_ * sizeof(int64_t));
+      } else {
+        memset(slot + sizeof(record), 0, stamps_ * sizeof(int64_t));
+      }
+    }
+  }
+
+ private:
+  uint32_t record_size_;
+  uint32_t stamps_;
+  uint64_t capacity_;
+  size_t size_ = 0;
+  char* data_ = nullptr;
+  CaptureHeader* header_ = nullptr;
+};
+
+// Reads a capture file written by CaptureWriter, oldest record first.
+class CaptureReader {
+ public:
+  explicit CaptureReader(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error("can't open " + path + ": " + strerror(errno));
+    }
+    struct stat st;
+    fstat(fd, &st);
+    size_ = st.st_size;
+    void* data = size_ >= sizeof(CaptureHeader)
+                     ? mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0)
+                     : MAP_FAILED;
+    close(fd);
+    if (data == MAP_FAILED) {
+      throw std::runtime_error("can't map " + path);
+    }
+    data_ = static_cast<const char*>(data);
+    header_ = reinterpret_cast<const CaptureHeader*>(data_);
+    if (memcmp(header_->magic, CaptureHeader::kMagic, sizeof(header_->magic)) != 0 ||
+        size_ < sizeof(CaptureHeader) + header_->capacity * header_->record_size) {
+      munmap(const_cast<char*>(data_), size_);
+      throw std::runtime_error(path + " is not a capture file");
+    }
+  }
+  ~CaptureReader() { munmap(const_cast<char*>(data_), size_); }
+
+  CaptureReader(const CaptureReader&) = delete;
+  CaptureReader& operator=(const CaptureReader&) = delete;
+
+  const CaptureHeader& header() const { return *header_; }
+  // Records in the file, and how many older ones the ring overwrote.
+  uint64_t size() const { return std::min(header_->written, header_->capacity); }
+  uint64_t overwritten() const { return header_->written - size(); }
+
+  // The i-th oldest record, and its per-hop timestamps.
+  const CaptureRecord& record(uint64_t i) const {
+    return *reinterpret_cast<const CaptureRecord*>(slot(i));
+  }
+  const int64_t* stamps(uint64_t i) const {
+    return reinterpret_cast<const int64_t*>(slot(i) + sizeof(CaptureRecord));
+  }
+
+ private:
+  const char* slot(uint64_t i) const {
+    uint64_t n = overwritten() + i;
+    return data_ + sizeof(CaptureHeader) + (n % header_->capacity) * header_->record_size;
+  }
+
+  size_t size_ = 0;
+  const char* data_ = nullptr;
+  const CaptureHeader* header_ = nullptr;
+};
+
+}  // namespace benchcore
@@ -0,0 +1,396 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "benchcore/batch.hpp"
+#include "benchcore/bulk.hpp"
+#include "benchcore/capture.hpp"
+#include "benchcore/clock.hpp"
+#include "benchcore/clock_sync.hpp"
+#include "benchcore/flags.hpp"
+#include "benchcore/idle.hpp"
+#include "benchcore/launcher.hpp"
+#include "benchcore/memory.hpp"
+#include "benchcore/report.hpp"
+#include "benchcore/scale.hpp"
+#include "benchcore/sequence.hpp"
+#include "benchcore/soak.hpp"
+#include "benchcore/traffic.hpp"
+#include "benchcore/warmup.hpp"
+
+namespace benchcore {
+
+// Every benchmark runs a source, kNumRelays relays and a sink, and the sink
+// reports after kNumSamples messages. The RPC benchmarks serve hop i on
+// kRelayPortStart + i, the sink being hop --relays.
+constexpr int kNumRelays = 20;
+constexpr int kRelayPortStart = 5000;
+constexpr int kNumSamples = 1000;
+
+// Prints the latency percentiles that the sweeps and rmwmatrix parse.
+inline void print_latency_stats(std::ostream& out, std::vector<int64_t> samples) {
+  std::sort(samples.begin(), samples.end());
+  out << "\nStats with " << samples.size() << " data points, ns/hop:"
+      << "\nP50 = " << samples[samples.size() / 2] / 1000
+      << "us, P90 = " << samples[samples.size() * 9 / 10] / 1000 << "us\n\n";
+}
+
+// The source's mean period between messages, from --rate-hz, 10 by default.
+inline std::chrono::nanoseconds source_period(const Flags& flags) {
+  return std::chrono::nanoseconds(static_cast<int64_t>(1e9 / flags.get_double("rate-hz", 10)));
+}
+
+// What a chain transport carries, in the transport's own message type.
+struct ChainMessage {
+  int64_t msgid = 0;
+  int64_t nanosec = 0;
+  std::string source;
+};
+
+// What a sink's LatencyRecorder needs beyond the flags.
+struct RecorderOptions {
+  int num_relays = kNumRelays;
+  // Parallel chains that each deliver every message, see pnode's --width.
+  int chains = 1;
+  // The source's first msgid.
+  int64_t first_msgid = 0;
+  // The source's mean period, for the burst positions of --traffic.
+  // source_period() unless set.
+  std::chrono::nanoseconds period{0};
+  // Messages per chain before the report.
+  int64_t messages = kNumSamples;
+  // Per-hop timestamps each record() passes, for --capture.
+  int stamps = 0;
+  // Whether to print the report sections and exit after the stats, or leave
+  // that to the caller, e.g. psrv's client with --chain-responses.
+  bool exit = true;
+  // Printed after the latency stats, e.g. pnode's dropped messages.
+  std::function<void(std::ostream&)> print_extra;
+  StartupReport* startup = nullptr;
+};
+
+// The sink's side of a chain: per-hop latency of every message, latency by
+// burst position, lost, reordered and duplicate messages per chain,
+// throughput with --batch-size, the first message for the startup report,
+// and with --capture every message to a capture file. With --warmup, the
+// first messages only count toward loss and the cold start report. With
+// --print-samples, prints every message's per-hop latency. Prints the stats
+// and the report sections and exits after the messages of every chain, or
+// with --soak-minutes only feeds the SoakMonitor, which ends the run.
+// Deliveries may overlap.
+class LatencyRecorder {
+ public:
+  LatencyRecorder(const Flags& flags, int num_relays, StartupReport* startup = nullptr)
+      : LatencyRecorder(flags, [&]() {
+          RecorderOptions options;
+          options.num_relays = num_relays;
+          options.startup = startup;
+          return options;
+        }()) {}
+
+  LatencyRecorder(const Flags& flags, RecorderOptions options)
+      : options_(std::move(options)),
+        batch_(BatchConfig::from_flags(flags)),
+        print_samples_(flags.get_bool("print-samples")),
+        burst_stats_(TrafficShape::from_flags(flags, options_.period.count() > 0
+                                                         ? options_.period
+                                                         : source_period(flags)),
+                     options_.first_msgid),
+        sequence_(options_.first_msgid, options_.chains),
+        soak_(SoakMonitor::from_flags(flags)),
+        capture_(CaptureWriter::from_flags(flags, options_.num_relays, options_.stamps)),
+        warmup_(Warmup::from_flags(flags)) {
+    data_.reserve(options_.messages * options_.chains);
+    BulkConfig bulk = BulkConfig::from_flags(flags);
+    if (bulk.enabled()) {
+      bulk_ = std::make_unique<BulkStats>(bulk, options_.num_relays);
+    }
+  }
+
+  // Called once per delivery, one message or a batch, before record() for
+  // each of its messages. Returns the arrival time.
+  int64_t arrived(int64_t messages) {
+    int64_t nanosec = now_ns();
+    std::lock_guard<std::mutex> lock(mutex_);
+    throughput_.add(messages, nanosec);
+    return nanosec;
+  }
+
+  // One message of chain `chain`, with options.stamps per-hop timestamps in
+  // `stamps` if set.
+  void record(int64_t msgid, int64_t sent_ns, int64_t arrived_ns, int chain = 0,
+              const int64_t* stamps = nullptr) {
+    if (options_.startup) {
+      options_.startup->mark("first message");
+    }
+    int64_t nanosec_per_hop = (arrived_ns - sent_ns) / (options_.num_relays + 1);
+    if (capture_) {
+      capture_->add(msgid, sent_ns, arrived_ns, stamps);
+    }
+    sequence_.add(msgid, arrived_ns, chain);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (reported_ || (warmup_ && warmup_->add(nanosec_per_hop))) {
+      return;
+    }
+    if (soak_) {
+      soak_->add(nanosec_per_hop);
+      return;
+    }
+    data_.push_back(nanosec_per_hop);
+    burst_stats_.add(msgid, nanosec_per_hop);
+    if (print_samples_) {
+      std::cout << "nano seconds per hop: " << nanosec_per_hop << "\n";
+    }
+    if (static_cast<int64_t>(data_.size()) >= options_.messages * options_.chains) {
+      report();
+    }
+  }
+
+  // A message of the bulk chain, see bulk.hpp, instead of arrived() and
+  // record().
+  void record_bulk(int64_t sent_ns) {
+    if (bulk_) {
+      bulk_->add(sent_ns, now_ns());
+    }
+  }
+
+  // The distinct msgids chain `chain` delivered so far, warmup included.
+  int64_t received(int chain = 0) { return sequence_.received(chain); }
+
+  // Reports before all messages arrived, e.g. when the rest were dropped.
+  void finish() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!reported_) {
+      report();
+    }
+  }
+
+ private:
+  void report() {
+    reported_ = true;
+    if (data_.empty()) {
+      std::cout << "\nNo messages received.\n\n";
+    } else {
+      print_latency_stats(std::cout, data_);
+    }
+    if (options_.print_extra) {
+      options_.print_extra(std::cout);
+    }
+    if (batch_.requested) {
+      throughput_.print(std::cout);
+    }
+    if (options_.exit) {
+      print_report_sections(std::cout);
+      exit(0);
+    }
+  }
+
+  RecorderOptions options_;
+  BatchConfig batch_;
+  bool print_samples_;
+  Throughput throughput_;
+  BurstStats burst_stats_;
+  SequenceTracker sequence_;
+  std::unique_ptr<SoakMonitor> soak_;
+  std::unique_ptr<BulkStats> bulk_;
+  std::unique_ptr<CaptureWriter> capture_;
+  std::unique_ptr<Warmup> warmup_;
+  std::mutex mutex_;
+  bool reported_ = false;
+  std::vector<int64_t> data_;
+};
+
+// One framework's RPC relay chain, for run_chain(). Relays forward each
+// request, or batch, to the next hop before they respond. start_relay() and
+// connect_relay() may run on several threads at once, see parallel_for().
+class ChainTransport {
+ public:
+  virtual ~ChainTransport() = default;
+
+  // Starts serving relay `hop`.
+  virtual void start_relay(int hop) = 0;
+  // Connects relay `hop` to hop + 1, retrying for up to retry_for while
+  // that one isn't listening yet.
+  virtual void connect_relay(int hop, std::chrono::milliseconds retry_for) = 0;
+  // Starts serving the sink at `hop`, passing every delivery to `recorder`.
+  virtual void start_sink(int hop, LatencyRecorder* recorder) = 0;
+  // Connects the source to hop 0, retrying like connect_relay().
+  virtual void connect_source(std::chrono::milliseconds retry_for) = 0;
+  // Sends one message, or several as a batch, and waits for the response.
+  virtual void send(std::vector<ChainMessage> messages) = 0;
+  // With --bulk-size, connects the bulk source to hop 0 like
+  // connect_source(). Relays forward bulk messages like the others, on
+  // connections of their own with --bulk-isolation=isolated.
+  virtual void connect_bulk_source(std::chrono::milliseconds retry_for) = 0;
+  // Sends one bulk message and waits for the response. May run at the same
+  // time as send().
+  virtual void send_bulk(ChainMessage message) = 0;
+  // Blocks while the servers run, i.e. until the sink exits.
+  virtual void wait() = 0;
+};
+
+// Sends kNumSamples messages to hop 0, and those of --warmup, or with
+// --soak-minutes keeps sending until the sink ends the run. --payload-size sets the size of each
+// message's source string. Messages are made at --rate-hz (default 10),
+// spaced by --traffic (see traffic.hpp), or with --batch-size sent in
+// batches at an even rate (see batch.hpp).
+inline void run_chain_source(const Flags& flags, ChainTransport& transport) {
+  std::string source = flags.has("payload-size")
+                           ? std::string(flags.get_int("payload-size", 0), 'x')
+                           : std::string("client");
+  auto make = [&](int i) {
+    ChainMessage message;
+    message.msgid = i;
+    message.source = source;
+    message.nanosec = now_ns();
+    return message;
+  };
+  int count = soak_requested(flags) ? std::numeric_limits<int>::max()
+                                    : kNumSamples + Warmup::extra_messages(flags);
+  BatchConfig batch = BatchConfig::from_flags(flags);
+  if (batch.requested) {
+    run_batched_source<ChainMessage>(
+        batch, source_period(flags), count, make,
+        [&](std::vector<ChainMessage> messages) { transport.send(std::move(messages)); });
+    return;
+  }
+  Pacer pacer(flags, source_period(flags));
+  for (int i = 0; i < count; ++i) {
+    transport.send({make(i)});
+    pacer.wait();
+  }
+}
+
+// Runs the source, and with --bulk-size the bulk source next to it until the
+// source is done.
+inline void run_chain_sources(const Flags& flags, ChainTransport& transport,
+                              std::chrono::milliseconds retry_for) {
+  BulkConfig bulk = BulkConfig::from_flags(flags);
+  std::unique_ptr<BulkSource> bulk_source;
+  if (bulk.enabled()) {
+    transport.connect_bulk_source(retry_for);
+    bulk_source = std::make_unique<BulkSource>(
+        bulk, [&transport](int64_t msgid, const std::string& payload) {
+          ChainMessage message;
+          message.msgid = msgid;
+          message.source = payload;
+          message.nanosec = now_ns();
+          transport.send_bulk(std::move(message));
+        });
+  }
+  run_chain_source(flags, transport);
+}
+
+// The driver of the RPC benchmarks, around a transport:
+//   --batch-sweep, --scale-sweep, --bulk-sweep
+//                                 run this binary once per setting
+//   --mp                          every hop in its own process, see launcher.hpp
+//   --role=relay|sink|client      one hop of an --mp run
+// and otherwise the whole chain of --relays relays in this process.
+inline int run_chain(const Flags& flags, ChainTransport& transport) {
+  using namespace std::chrono_literals;
+  // With --batch-sweep=1,8,64, run this binary once per batch size.
+  if (flags.has("batch-sweep")) {
+    return run_batch_sweep(flags);
+  }
+  // With --scale-sweep=100,1000,..., run this binary once per relay count.
+  if (flags.has("scale-sweep")) {
+    return run_scale_sweep(flags);
+  }
+  // With --bulk-sweep, run it alone and next to a shared and an isolated bulk
+  // chain.
+  if (flags.get_bool("bulk-sweep")) {
+    return run_bulk_sweep(flags);
+  }
+  // Batches are sent on the flush timer, not at the times --traffic picks.
+  if (!TrafficShape::from_flags(flags, source_period(flags)).uniform() &&
+      BatchConfig::from_flags(flags).requested) {
+    throw std::invalid_argument("--traffic doesn't work with --batch-size");
+  }
+  // --relays sets the length of the chain, and the sink's port.
+  int num_relays = flags.get_int("relays", kNumRelays);
+  raise_fd_limit();
+
+  // With --mp, every relay, the sink and the client run in their own
+  // process. The launcher starts this binary again once per --role.
+  if (flags.get_bool("mp")) {
+    return launch_multi_process(flags, num_relays);
+  }
+  // Timestamps are taken with the clock selected with --clock.
+  init_clock(flags);
+  std::string role = flags.get("role");
+  // With --memmon, sample memory from before the servers are created. A
+  // role process runs one of them, otherwise it's all servers and the client.
+  auto memory = MemorySampler::from_flags(flags, role.empty() ? num_relays + 2 : 1,
+                                          flags.get_int("payload-size", 6));
+  if (role == "relay") {
+    int index = flags.get_int("index", 0);
+    transport.start_relay(index);
+    transport.connect_relay(index, 10000ms);
+    transport.wait();
+    return 0;
+  }
+  if (role == "sink") {
+    ClockSyncServer clock_sync(flags, num_relays + 1);
+    LatencyRecorder recorder(flags, num_relays);
+    transport.start_sink(num_relays, &recorder);
+    IdleAnalysis idle_analysis(flags);
+    transport.wait();
+    return 0;
+  }
+  if (role == "client") {
+    // Stamp requests in the sink's timebase.
+    sync_clock(flags);
+    // The first relay runs in another process and may still be starting up.
+    transport.connect_source(10000ms);
+    run_chain_sources(flags, transport, 10000ms);
+    return 0;
+  }
+
+  // With --relays or --startup, time server creation, the relays connecting
+  // to their next hop and the first request at the sink.
+  std::unique_ptr<StartupReport> startup;
+  if (flags.has("relays") || flags.get_bool("startup")) {
+    startup = std::make_unique<StartupReport>(num_relays + 1);
+  }
+
+  // Create the relay and sink services, on --create-threads threads.
+  parallel_for(flags, num_relays, [&](int i) { transport.start_relay(i); });
+  LatencyRecorder recorder(flags, num_relays, startup.get());
+  transport.start_sink(num_relays, &recorder);
+  if (startup) {
+    startup->mark("create");
+  }
+  // Connect each relay to its next hop, retrying while the servers start
+  // listening.
+  parallel_for(flags, num_relays, [&](int i) { transport.connect_relay(i, 10000ms); });
+  if (startup) {
+    startup->mark("connect");
+  }
+  // Give them a second to settle so not to interfere with benchmark run.
+  std::this_thread::sleep_for(1s);
+  std::cout << "Services initialized.\n";
+  IdleAnalysis idle_analysis(flags);
+
+  // Create the client and send requests.
+  transport.connect_source(0ms);
+  run_chain_sources(flags, transport, 0ms);
+  transport.wait();
+  return 0;
+}
+
+}  // namespace benchcore
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "benchcore/flags.hpp"
+#include "benchcore/report.hpp"
+
+namespace benchcore {
+
+// The clocks latency can be measured with, selected with --clock.
+enum class ClockSource {
+  kSteady,        // std::chrono::steady_clock, i.e. CLOCK_MONOTONIC. The default.
+  kMonotonicRaw,  // CLOCK_MONOTONIC_RAW, not slewed by NTP.
+  kTsc,           // The CPU's time stamp counter (cntvct_el0 on ARM), scaled to ns.
+};
+
+inline const char* clock_source_name(ClockSource source) {
+  switch (source) {
+    case ClockSource::kSteady:
+      return "steady";
+    case ClockSource::kMonotonicRaw:
+      return "raw";
+    case ClockSource::kTsc:
+      return "tsc";
+  }
+  return "unknown";
+}
+
+inline int64_t monotonic_raw_ns() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+inline uint64_t read_tsc() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#elif defined(__aarch64__)
+  uint64_t ticks;
+  asm volatile("isb; mrs %0, cntvct_el0" : "=r"(ticks));
+  return ticks;
+#else
+  return static_cast<uint64_t>(monotonic_raw_ns());
+#endif
+}
+
+// The process wide clock all benchmark timestamps are taken with.
+//
+// The TSC is converted to ns against CLOCK_MONOTONIC_RAW. On ARM the counter
+// frequency is read from cntfrq_el0. On x86 it is calibrated over
+// kCalibration at init, and the calibration error is kept as a rate
+// uncertainty in ppm, since it turns into drift between processes that
+// calibrated separately.
+//
+// An offset can be added to all timestamps, so a source in one process can
+// stamp messages in the timebase of a sink in another, see clock_sync.hpp.
+class Clock {
+ public:
+  static constexpr std::chrono::milliseconds kCalibration{100};
+
+  static Clock& instance() {
+    static Clock clock;
+    return clock;
+  }
+
+  void init(ClockSource source) {
+    source_ = source;
+    if (source_ != ClockSource::kTsc) {
+      return;
+    }
+#if defined(__aarch64__)
+    uint64_t frequency;
+    asm volatile("mrs %0, cntfrq_el0" : "=r"(frequency));
+    ns_per_tick_ = 1e9 / static_cast<double>(frequency);
+    rate_ppm_ = 0;
+    base_ticks_ = read_tsc();
+    base_ns_ = monotonic_raw_ns();
+#else
+    // Take the reads at both ends of the interval with the shortest time
+    // between the two clock reads, to bound how much they are apart.
+    auto bracket = [](uint64_t& ticks, int64_t& ns) {
+      int64_t best_gap = INT64_MAX;
+      for (int i = 0; i < 100; ++i) {
+        int64_t before = monotonic_raw_ns();
+        uint64_t t = read_tsc();
+        int64_t after = monotonic_raw_ns();
+        if (after - before < best_gap) {
+          best_gap = after - before;
+          ticks = t;
+          ns = before + (after - before) / 2;
+        }
+      }
+      return best_gap;
+    };
+    int64_t start_gap = bracket(base_ticks_, base_ns_);
+    std::this_thread::sleep_for(kCalibration);
+    uint64_t end_ticks = 0;
+    int64_t end_ns = 0;
+    int64_t end_gap = bracket(end_ticks, end_ns);
+    double elapsed_ns = static_cast<double>(end_ns - base_ns_);
+    ns_per_tick_ = elapsed_ns / static_cast<double>(end_ticks - base_ticks_);
+    rate_ppm_ = 1e6 * static_cast<double>(start_gap + end_gap) / elapsed_ns;
+#endif
+  }
+
+  int64_t now_ns() const {
+    switch (source_) {
+      case ClockSource::kSteady:
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+                   .count() +
+               offset_ns_.load(std::memory_order_relaxed);
+      case ClockSource::kMonotonicRaw:
+        return monotonic_raw_ns() + offset_ns_.load(std::memory_order_relaxed);
+      case ClockSource::kTsc:
+        return base_ns_ +
+               static_cast<int64_t>(static_cast<double>(read_tsc() - base_ticks_) * ns_per_tick_) +
+               offset_ns_.load(std::memory_order_relaxed);
+    }
+    return 0;
+  }
+
+  // Timestamps taken after this are shifted by offset_ns.
+  void set_offset(int64_t offset_ns) { offset_ns_.store(offset_ns, std::memory_order_relaxed); }
+  int64_t offset() const { return offset_ns_.load(std::memory_order_relaxed); }
+
+  ClockSource source() const { return source_; }
+  // Uncertainty of the TSC rate in ppm. 0 for the other clocks.
+  double rate_ppm() const { return source_ == ClockSource::kTsc ? rate_ppm_ : 0; }
+
+  void print(std::ostream& out) const {
+    out << "Clock: " << clock_source_name(source_);
+    if (source_ == ClockSource::kTsc) {
+      out << ", " << 1e3 / ns_per_tick_ << " MHz +-" << rate_ppm_ << " ppm";
+    }
+    out << "\n";
+  }
+
+ private:
+  Clock() = default;
+
+  ClockSource source_ = ClockSource::kSteady;
+  uint64_t base_ticks_ = 0;
+  int64_t base_ns_ = 0;
+  double ns_per_tick_ = 1;
+  double rate_ppm_ = 0;
+  std::atomic<int64_t> offset_ns_{0};
+};
+
+// Selects the clock with --clock=steady|raw|tsc. A selected clock is
+// printed with the report.
+inline void init_clock(const Flags& flags) {
+  std::string name = flags.get("clock", "steady");
+  if (name == "steady") {
+    Clock::instance().init(ClockSource::kSteady);
+  } else if (name == "raw") {
+    Clock::instance().init(ClockSource::kMonotonicRaw);
+  } else if (name == "tsc") {
+    Clock::instance().init(ClockSource::kTsc);
+  } else {
+    throw std::invalid_argument("unknown clock: " + name);
+  }
+  if (flags.has("clock")) {
+    add_report_section([](std::ostream& out) {
+      Clock::instance().print(out);
+      out << "\n";
+    });
+  }
+}
+
+// The current time of the benchmark clock, in ns.
+inline int64_t now_ns() { return Clock::instance().now_ns(); }
+
+}  // namespace benchcore
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <ostream>
+#include <string>
+#include <thread>
+
+#include "benchcore/clock.hpp"
+#include "benchcore/flags.hpp"
+#include "benchcore/report.hpp"
+
+namespace benchcore {
+
+// Clock offset estimation between the process stamping messages (the
+// source) and the one computing latency from them (the sink), so latency
+// measured across processes is within known error bounds.
+//
+// The sink runs a ClockSyncServer on a UDP port. Before sending, the source
+// calls sync_clock(), which sends kSyncPings pings and takes the one with
+// the smallest round trip, NTP style: offset = t_sink - (t_send + t_recv) / 2,
+// with an error bound of half that round trip. The offset is then added to
+// the source's clock, so its timestamps are in the sink's timebase, and the
+// result is sent to the sink to be reported with its stats.
+
+constexpr int kClockSyncPort = 4999;
+constexpr int kSyncPings = 200;
+
+struct ClockSyncPacket {
+  enum Type : uint32_t { kPing, kPong, kResult };
+  uint32_t type;
+  uint32_t seq;
+  int64_t t_send;  // kPing/kPong: source clock at send. kResult: offset.
+  int64_t t_sink;  // kPong: sink clock at receive. kResult: error bound.
+  int64_t min_rtt;  // kResult: round trip of the sample used.
+};
+
+inline sockaddr_in clock_sync_address(const Flags& flags) {
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(flags.get_int("clock-sync-port", kClockSyncPort));
+  inet_pton(AF_INET, flags.get("clock-sync-host", "127.0.0.1").c_str(), &addr.sin_addr);
+  return addr;
+}
+
+// Answers pings from the source and keeps the offset it settled on. Reports
+// the error bound of the latency stats, per hop for hops > 1.
+class ClockSyncServer {
+ public:
+  ClockSyncServer(const Flags& flags, int hops) : hops_(hops) {
+    fd_ = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in addr = clock_sync_address(flags);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+      perror("clock sync bind");
+    }
+    thread_ = std::thread([this]() { serve(); });
+    add_report_section([this](std::ostream& out) { print(out); });
+  }
+
+  ~ClockSyncServer() {
+    stop_ = true;
+    thread_.join();
+    close(fd_);
+  }
+
+  bool synced() const { return synced_; }
+
+  void print(std::ostream& out) const {
+    if (!synced_) {
+      out << "Clock sync: no source synced, cross-process latency is unbounded.\n\n";
+      return;
+    }
+    out << "Clock sync: source offset " << offset_ << "ns, error bound +-" << error_
+        << "ns (min round trip " << min_rtt_ << "ns over " << kSyncPings << " pings)\n";
+    if (hops_ > 1) {
+      out << "Latency error bound: +-" << static_cast<double>(error_) / hops_ / 1000
+          << "us/hop\n";
+    }
+    if (Clock::instance().rate_ppm() > 0) {
+      out << "Plus up to " << Clock::instance().rate_ppm()
+          << "ns per ms since the sync from TSC rate calibration.\n";
+    }
+    out << "\n";
+  }
+
+ private:
+  void serve() {
+    while (!stop_) {
+      pollfd pfd{fd_, POLLIN, 0};
+      if (poll(&pfd, 1, 100) <= 0) {
+        continue;
+      }
+      ClockSyncPacket packet;
+      sockaddr_in from{};
+      socklen_t from_len = sizeof(from);
+      ssize_t n = recvfrom(fd_, &packet, sizeof(packet), 0, reinterpret_cast<sockaddr*>(&from),
+                           &from_len);
+      if (n != sizeof(packet)) {
+        continue;
+      }
+      if (packet.type == ClockSyncPacket::kPing) {
+        packet.t_sink = now_ns();
+        packet.type = ClockSyncPacket::kPong;
+        sendto(fd_, &packet, sizeof(packet), 0, reinterpret_cast<sockaddr*>(&from), from_len);
+      } else if (packet.type == ClockSyncPacket::kResult) {
+        offset_ = packet.t_send;
+        error_ = packet.t_sink;
+        min_rtt_ = packet.min_rtt;
+        synced_ = true;
+      }
+    }
+  }
+
+  int hops_;
+  int fd_;
+  std::thread thread_;
+  std::atomic<bool> stop_{false};
+  std::atomic<bool> synced_{false};
+  int64_t offset_ = 0;
+  int64_t error_ = 0;
+  int64_t min_rtt_ = 0;
+};
+
+// Estimates the offset to the sink's clock and applies it to this process's
+// clock. Retries for up to timeout while the sink isn't up yet. Returns
+// false if no pong came back.
+inline bool sync_clock(const Flags& flags,
+                       std::chrono::milliseconds timeout = std::chrono::milliseconds(10000)) {
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  sockaddr_in addr = clock_sync_address(flags);
+  connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+
+  // Raw timestamps, without a previously applied offset.
+  Clock::instance().set_offset(0);
+  int64_t best_rtt = INT64_MAX;
+  int64_t best_offset = 0;
+  auto deadline = std::chrono::steady_clock::now() + timeout;
+  int pongs = 0;
+  for (uint32_t seq = 0; pongs < kSyncPings && std::chrono::steady_clock::now() < deadline;
+       ++seq) {
+    ClockSyncPacket packet{ClockSyncPacket::kPing, seq, now_ns(), 0, 0};
+    send(fd, &packet, sizeof(packet), 0);
+    pollfd pfd{fd, POLLIN, 0};
+    if (poll(&pfd, 1, 100) <= 0) {
+      continue;
+    }
+    ClockSyncPacket pong;
+    // Refused while the sink isn't listening yet.
+    if (recv(fd, &pong, sizeof(pong), 0) != sizeof(pong)) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      continue;
+    }
+    int64_t t_recv = now_ns();
+    if (pong.type != ClockSyncPacket::kPong || pong.seq != seq) {
+      continue;
+    }
+    ++pongs;
+    int64_t rtt = t_recv - pong.t_send;
+    if (rtt < best_rtt) {
+      best_rtt = rtt;
+      best_offset = pong.t_sink - (pong.t_send + t_recv) / 2;
+    }
+  }
+  if (pongs == 0) {
+    close(fd);
+    std::cout << "Clock sync failed, no response from the sink.\n";
+    return false;
+  }
+  Clock::instance().set_offset(best_offset);
+  ClockSyncPacket result{ClockSyncPacket::kResult, 0, best_offset, (best_rtt + 1) / 2, best_rtt};
+  send(fd, &result, sizeof(result), 0);
+  close(fd);
+  std::cout << "Clock synced to the sink: offset " << best_offset << "ns +-" << (best_rtt + 1) / 2
+            << "ns\n";
+  return true;
+}
+
+}  // namespace benchcore
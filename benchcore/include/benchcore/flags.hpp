@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace benchcore {
+
+// Command line flags of the form "--name=value" or "--name". Arguments that
+// don't start with "--" are kept as positional arguments. The first argument
+// is the program name and is skipped.
+class Flags {
+ public:
+  Flags(int argc, char* argv[]) : Flags(std::vector<std::string>(argv, argv + argc)) {}
+  explicit Flags(const std::vector<std::string>& args) : args_(args) {
+    for (size_t i = 1; i < args.size(); ++i) {
+      const std::string& arg = args[i];
+      if (arg.rfind("--", 0) != 0) {
+        positional_.push_back(arg);
+        continue;
+      }
+      size_t eq = arg.find('=');
+      if (eq == std::string::npos) {
+        values_[arg.substr(2)] = "true";
+      } else {
+        values_[arg.substr(2, eq - 2)] = arg.substr(eq + 1);
+      }
+    }
+  }
+
+  bool has(const std::string& name) const { return values_.count(name) > 0; }
+
+  std::string get(const std::string& name, const std::string& fallback = "") const {
+    auto it = values_.find(name);
+    return it == values_.end() ? fallback : it->second;
+  }
+
+  int64_t get_int(const std::string& name, int64_t fallback) const {
+    auto it = values_.find(name);
+    return it == values_.end() ? fallback : std::stoll(it->second);
+  }
+
+  double get_double(const std::string& name, double fallback) const {
+    auto it = values_.find(name);
+    return it == values_.end() ? fallback : std::stod(it->second);
+  }
+
+  bool get_bool(const std::string& name, bool fallback = false) const {
+    auto it = values_.find(name);
+    if (it == values_.end()) {
+      return fallback;
+    }
+    return it->second == "true" || it->second == "1" || it->second == "yes";
+  }
+
+  const std::vector<std::string>& positional() const { return positional_; }
+
+  // All arguments as passed in, including the program name.
+  const std::vector<std::string>& args() const { return args_; }
+
+ private:
+  std::vector<std::string> args_;
+  std::map<std::string, std::string> values_;
+  std::vector<std::string> positional_;
+};
+
+// Splits a comma separated flag value, e.g. "spin:2,membw:1".
+inline std::vector<std::string> split(const std::string& value, char separator = ',') {
+  std::vector<std::string> parts;
+  size_t start = 0;
+  while (start <= value.size()) {
+    size_t end = value.find(separator, start);
+    if (end == std::string::npos) {
+      end = value.size();
+    }
+    if (end > start) {
+      parts.push_back(value.substr(start, end - start));
+    }
+    start = end + 1;
+  }
+  return parts;
+}
+
+}  // namespace benchcore
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <memory>
+#include <ostream>
+
+#include "benchcore/flags.hpp"
+#include "benchcore/load.hpp"
+#include "benchcore/report.hpp"
+#include "benchcore/sysmon.hpp"
+
+namespace benchcore {
+
+// The latency-vs-idle analysis mode: optional background load threads plus
+// CPU frequency and idle state sampling, both reported after the latency
+// stats. Construct it right before the first message is sent.
+//
+//   --load=spin:2,membw:1,cache:1  background load threads per kind
+//   --load-duty=50                 percent of each 1ms period the load runs
+//   --load-cpus=2,3                pin load threads to these CPUs
+//   --sysmon                       sample /sys even without --load
+//   --sysmon-period-ms=100         frequency sample period
+class IdleAnalysis {
+ public:
+  explicit IdleAnalysis(const Flags& flags)
+      : load_(BackgroundLoad::from_flags(flags)), sampler_(CpuSampler::from_flags(flags)) {
+    if (load_ || sampler_) {
+      add_report_section([this](std::ostream& out) { print(out); });
+    }
+  }
+
+  void print(std::ostream& out) {
+    if (load_) {
+      load_->print(out);
+    }
+    if (sampler_) {
+      sampler_->print(out);
+    }
+  }
+
+ private:
+  std::unique_ptr<BackgroundLoad> load_;
+  std::unique_ptr<CpuSampler> sampler_;
+};
+
+}  // namespace benchcore
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace benchcore {
+
+// Timer callback lateness, i.e. how long after its scheduled time a periodic
+// callback actually ran, as a histogram with percentiles.
+class LatenessHistogram {
+ public:
+  explicit LatenessHistogram(std::string name) : name_(std::move(name)) {}
+
+  void add(int64_t lateness_ns) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    samples_.push_back(lateness_ns);
+  }
+  // Periods the callback didn't run at all, because a previous run was late
+  // by more than a period.
+  void add_missed(int64_t periods) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    missed_ += periods;
+  }
+  size_t size() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return samples_.size();
+  }
+
+  // Returns "P50/P99/max" in us, for a summary table.
+  std::string summary() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<int64_t> sorted = sorted_samples();
+    if (sorted.empty()) {
+      return "-";
+    }
+    return std::to_string(percentile(sorted, 50) / 1000) + "/" +
+           std::to_string(percentile(sorted, 99) / 1000) + "/" +
+           std::to_string(sorted.back() / 1000);
+  }
+
+  void print(std::ostream& out) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<int64_t> sorted = sorted_samples();
+    out << "Timer lateness, " << name_ << ", " << sorted.size() << " samples:\n";
+    if (sorted.empty()) {
+      out << "\n";
+      return;
+    }
+    out << "  min " << sorted.front() / 1000 << "us, P50 " << percentile(sorted, 50) / 1000
+        << "us, P90 " << percentile(sorted, 90) / 1000 << "us, P99 "
+        << percentile(sorted, 99) / 1000 << "us, max " << sorted.back() / 1000
+        << "us, missed periods " << missed_ << "\n";
+
+    // Buckets up to 1, 2, 5, 10, ... us, and one for the rest.
+    static const std::vector<int64_t> kBoundsUs = {1,   2,   5,    10,   20,   50,    100,
+                                                   200, 500, 1000, 2000, 5000, 10000};
+    std::vector<size_t> counts(kBoundsUs.size() + 1, 0);
+    for (int64_t ns : sorted) {
+      size_t i = 0;
+      while (i < kBoundsUs.size() && ns >= kBoundsUs[i] * 1000) {
+        ++i;
+      }
+      counts[i]++;
+    }
+    size_t most = *std::max_element(counts.begin(), counts.end());
+    // Skip the empty buckets below the min and above the max.
+    size_t first = 0;
+    while (counts[first] == 0) {
+      ++first;
+    }
+    size_t last = counts.size() - 1;
+    while (counts[last] == 0) {
+      --last;
+    }
+    for (size_t i = first; i <= last; ++i) {
+      std::string label = i < kBoundsUs.size() ? "< " + std::to_string(kBoundsUs[i]) + "us"
+                                               : ">= " + std::to_string(kBoundsUs.back()) + "us";
+      label.insert(0, 10 - std::min<size_t>(10, label.size()), ' ');
+      out << "  " << label << " |" << std::string(counts[i] * 40 / most, '#')
+          << std::string(40 - counts[i] * 40 / most, ' ') << "| " << counts[i] << "\n";
+    }
+    out << "\n";
+  }
+
+ private:
+  std::vector<int64_t> sorted_samples() const {
+    std::vector<int64_t> sorted = samples_;
+    std::sort(sorted.begin(), sorted.end());
+    return sorted;
+  }
+  static int64_t percentile(const std::vector<int64_t>& sorted, int p) {
+    return sorted[sorted.size() * p / 100];
+  }
+
+  std::string name_;
+  std::mutex mutex_;
+  std::vector<int64_t> samples_;
+  int64_t missed_ = 0;
+};
+
+// Records the lateness of a periodic timer, such as an rclcpp wall timer,
+// that runs its callback at start + n * period, skipping the periods it
+// missed. Every run is measured against the slot it was due in, the one
+// after the previous run's, so a run late by more than a period counts in
+// full, and the slots passed since are missed periods. Construct it right
+// before the timer, and call tick() first thing in the callback.
+class PeriodicLateness {
+ public:
+  PeriodicLateness(std::chrono::nanoseconds period, LatenessHistogram* histogram)
+      : period_(period.count()), histogram_(histogram), start_(steady_ns()) {}
+
+  void tick() {
+    int64_t since_start = steady_ns() - start_;
+    // The first run is due one period after the start.
+    int64_t due = last_slot_ + 1;
+    histogram_->add(since_start - due * period_);
+    int64_t slot = since_start / period_;
+    if (slot > due) {
+      histogram_->add_missed(slot - due);
+    }
+    last_slot_ = std::max(slot, due);
+  }
+
+  static int64_t steady_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+ private:
+  int64_t period_;
+  LatenessHistogram* histogram_;
+  int64_t start_;
+  int64_t last_slot_ = 0;
+};
+
+}  // namespace benchcore
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchcore/flags.hpp"
+
+namespace benchcore {
+
+// Starts this executable again as one role of the chain, with the same
+// flags minus --mp. If stdout_fd is valid, the child's stdout goes there.
+inline pid_t spawn_role(const Flags& flags, const std::string& role, int index,
+                        int stdout_fd = -1) {
+  std::vector<std::string> args;
+  for (const std::string& arg : flags.args()) {
+    if (arg != "--mp" && arg.rfind("--mp=", 0) != 0) {
+      args.push_back(arg);
+    }
+  }
+  args.push_back("--role=" + role);
+  args.push_back("--index=" + std::to_string(index));
+
+  pid_t pid = fork();
+  if (pid != 0) {
+    return pid;
+  }
+  if (stdout_fd >= 0) {
+    dup2(stdout_fd, STDOUT_FILENO);
+  }
+  std::vector<char*> argv;
+  for (std::string& arg : args) {
+    argv.push_back(arg.data());
+  }
+  argv.push_back(nullptr);
+  execv("/proc/self/exe", argv.data());
+  perror("execv");
+  _exit(127);
+}
+
+// Runs the chain with the client, each relay and the sink in their own
+// process, like zenohbench/run_mp_bench.sh. The sink starts first, then the
+// relays from last to first so every relay's downstream hop is already
+// listening, then the client. The sink's output is forwarded, and its stats
+// lines are repeated at the end. Returns once the sink exits, or kill_after
+// after the client exited if the sink never completes, e.g. on drops.
+inline int launch_multi_process(const Flags& flags, int num_relays,
+                                std::chrono::milliseconds stagger = std::chrono::milliseconds(200),
+                                std::chrono::seconds kill_after = std::chrono::seconds(10)) {
+  int fds[2];
+  if (pipe2(fds, O_CLOEXEC) != 0) {
+    perror("pipe2");
+    return 1;
+  }
+  std::cout << "Starting sink" << std::flush;
+  pid_t sink = spawn_role(flags, "sink", num_relays, fds[1]);
+  close(fds[1]);
+  std::vector<pid_t> others;
+  for (int i = num_relays - 1; i >= 0; --i) {
+    std::this_thread::sleep_for(stagger);
+    std::cout << ", relay " << i << std::flush;
+    others.push_back(spawn_role(flags, "relay", i));
+  }
+  std::this_thread::sleep_for(stagger);
+  std::cout << ", client.\n" << std::flush;
+  pid_t client = spawn_role(flags, "client", 0);
+  others.push_back(client);
+
+  // Forward the sink's output until it exits.
+  std::vector<std::string> stats;
+  std::string line;
+  bool client_done = false;
+  auto client_exit_time = std::chrono::steady_clock::now();
+  while (true) {
+    pollfd pfd{fds[0], POLLIN, 0};
+    if (poll(&pfd, 1, 100) > 0) {
+      char buf[4096];
+      ssize_t n = read(fds[0], buf, sizeof(buf));
+      if (n <= 0) {
+        break;
+      }
+      std::cout.write(buf, n).flush();
+      for (ssize_t i = 0; i < n; ++i) {
+        if (buf[i] != '\n') {
+          line += buf[i];
+          continue;
+        }
+        if (line.find("P50") != std::string::npos || line.find("Stats") == 0 ||
+            line.find("Clock") == 0 || line.find("Latency error bound") == 0) {
+          stats.push_back(line);
+        }
+        line.clear();
+      }
+    }
+    if (!client_done && waitpid(client, nullptr, WNOHANG) == client) {
+      client_done = true;
+      client_exit_time = std::chrono::steady_clock::now();
+    }
+    if (client_done && std::chrono::steady_clock::now() - client_exit_time > kill_after) {
+      std::cout << "Sink didn't complete " << kill_after.count()
+                << "s after the client finished, stopping.\n";
+      kill(sink, SIGTERM);
+      break;
+    }
+  }
+  close(fds[0]);
+  int status = 0;
+  waitpid(sink, &status, 0);
+  for (pid_t pid : others) {
+    kill(pid, SIGTERM);
+  }
+  for (pid_t pid : others) {
+    if (pid != client || !client_done) {
+      waitpid(pid, nullptr, 0);
+    }
+  }
+
+  std::cout << "\nMulti-process run with " << num_relays << " relays:\n";
+  for (const std::string& s : stats) {
+    std::cout << "  " << s << "\n";
+  }
+  return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
+
+}  // namespace benchcore
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchcore/flags.hpp"
+
+namespace benchcore {
+
+// The kinds of background load that can run alongside a benchmark chain.
+enum class LoadKind {
+  kSpin,             // Integer arithmetic in registers, keeps a core busy.
+  kMemoryBandwidth,  // Sequential copies over a buffer larger than the LLC.
+  kCacheThrash,      // Random cache line writes over a buffer larger than the LLC.
+};
+
+inline const char* load_kind_name(LoadKind kind) {
+  switch (kind) {
+    case LoadKind::kSpin:
+      return "spin";
+    case LoadKind::kMemoryBandwidth:
+      return "membw";
+    case LoadKind::kCacheThrash:
+      return "cache";
+  }
+  return "unknown";
+}
+
+struct LoadSpec {
+  LoadKind kind;
+  int threads;
+};
+
+// Parses a load spec such as "spin:2,membw:1,cache:1". The thread count
+// defaults to 1 when omitted.
+inline std::vector<LoadSpec> parse_load_specs(const std::string& value) {
+  std::vector<LoadSpec> specs;
+  for (const std::string& part : split(value)) {
+    std::vector<std::string> kv = split(part, ':');
+    LoadSpec spec{LoadKind::kSpin, kv.size() > 1 ? std::stoi(kv[1]) : 1};
+    if (kv[0] == "spin") {
+      spec.kind = LoadKind::kSpin;
+    } else if (kv[0] == "membw") {
+      spec.kind = LoadKind::kMemoryBandwidth;
+    } else if (kv[0] == "cache") {
+      spec.kind = LoadKind::kCacheThrash;
+    } else {
+      throw std::invalid_argument("unknown load kind: " + kv[0]);
+    }
+    specs.push_back(spec);
+  }
+  return specs;
+}
+
+// Pins the calling thread to the given CPU. Returns false if that fails,
+// e.g. when the CPU is outside the process' cpuset.
+inline bool pin_current_thread(int cpu) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+// Runs background load threads until destroyed.
+// Each thread works for duty_percent of every kLoadPeriod and sleeps for the
+// rest, so the load level, and with it how deep the CPUs get to idle, can be
+// controlled independently of the benchmark's own message rate.
+class BackgroundLoad {
+ public:
+  static constexpr std::chrono::microseconds kLoadPeriod{1000};
+  static constexpr size_t kBufferBytes = 64 << 20;
+  static constexpr size_t kCacheLine = 64;
+
+  BackgroundLoad(const std::vector<LoadSpec>& specs, int duty_percent, std::vector<int> cpus)
+      : specs_(specs), duty_percent_(duty_percent), cpus_(std::move(cpus)) {
+    for (const LoadSpec& spec : specs_) {
+      for (int i = 0; i < spec.threads; ++i) {
+        int cpu = cpus_.empty() ? -1 : cpus_[threads_.size() % cpus_.size()];
+        threads_.emplace_back([this, kind = spec.kind, cpu]() { run(kind, cpu); });
+      }
+    }
+  }
+
+  // Creates the load configured with --load, --load-duty and --load-cpus,
+  // or returns nullptr if --load isn't set.
+  static std::unique_ptr<BackgroundLoad> from_flags(const Flags& flags) {
+    if (!flags.has("load")) {
+      return nullptr;
+    }
+    std::vector<int> cpus;
+    for (const std::string& cpu : split(flags.get("load-cpus"))) {
+      cpus.push_back(std::stoi(cpu));
+    }
+    return std::make_unique<BackgroundLoad>(parse_load_specs(flags.get("load")),
+                                            flags.get_int("load-duty", 100), std::move(cpus));
+  }
+
+  ~BackgroundLoad() {
+    stop_ = true;
+    for (auto& thread : threads_) {
+      thread.join();
+    }
+  }
+
+  void print(std::ostream& out) const {
+    out << "Background load (" << duty_percent_ << "% duty):";
+    for (const LoadSpec& spec : specs_) {
+      out << " " << load_kind_name(spec.kind) << " x" << spec.threads;
+    }
+    if (!cpus_.empty()) {
+      out << ", pinned to cpus";
+      for (int cpu : cpus_) {
+        out << " " << cpu;
+      }
+    }
+    out << ", " << work_units_.load() << " work units done\n";
+  }
+
+ private:
+  void run(LoadKind kind, int cpu) {
+    if (cpu >= 0) {
+      pin_current_thread(cpu);
+    }
+    std::vector<uint8_t> buffer;
+    if (kind != LoadKind::kSpin) {
+      buffer.resize(kBufferBytes, 1);
+    }
+    std::mt19937_64 rng(reinterpret_cast<uintptr_t>(&buffer));
+    uint64_t acc = 1;
+    size_t cursor = 0;
+    auto busy = kLoadPeriod * duty_percent_ / 100;
+
+    while (!stop_) {
+      auto period_start = std::chrono::steady_clock::now();
+      uint64_t units = 0;
+      do {
+        switch (kind) {
+          case LoadKind::kSpin:
+            for (int i = 0; i < 1000; ++i) {
+              acc = acc * 6364136223846793005ULL + 1442695040888963407ULL;
+            }
+            break;
+          case LoadKind::kMemoryBandwidth: {
+            // Copy the first half of the buffer onto the second half, in
+            // chunks so the time check stays responsive.
+            size_t half = buffer.size() / 2;
+            std::copy_n(buffer.data() + cursor, kChunkBytes, buffer.data() + half + cursor);
+            cursor = (cursor + kChunkBytes) % half;
+            break;
+          }
+          case LoadKind::kCacheThrash:
+            for (int i = 0; i < 1000; ++i) {
+              size_t line = rng() % (buffer.size() / kCacheLine);
+              buffer[line * kCacheLine] += static_cast<uint8_t>(acc++);
+            }
+            break;
+        }
+        ++units;
+      } while (!stop_ && std::chrono::steady_clock::now() - period_start < busy);
+      work_units_ += units;
+      if (duty_percent_ < 100) {
+        std::this_thread::sleep_until(period_start + kLoadPeriod);
+      }
+    }
+    sink_ += acc;
+  }
+
+  static constexpr size_t kChunkBytes = 64 << 10;
+
+  std::vector<LoadSpec> specs_;
+  int duty_percent_;
+  std::vector<int> cpus_;
+  std::atomic<bool> stop_{false};
+  std::atomic<uint64_t> work_units_{0};
+  std::atomic<uint64_t> sink_{0};
+  std::vector<std::thread> threads_;
+};
+
+}  // namespace benchcore
@@ -0,0 +1,213 @@
+#pragma once
+
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+
+#include "benchcore/flags.hpp"
+#include "benchcore/report.hpp"
+
+namespace benchcore {
+
+// Reads a "Name:   1234 kB" field of /proc/self/status, e.g. VmRSS or
+// VmHWM (the peak RSS), or of another file in that format. Returns -1 if
+// it's not there.
+inline int64_t proc_status_kb(const std::string& field,
+                              const std::string& path = "/proc/self/status") {
+  std::ifstream in(path);
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.compare(0, field.size(), field) == 0 && line.size() > field.size() &&
+        line[field.size()] == ':') {
+      return std::stoll(line.substr(field.size() + 1));
+    }
+  }
+  return -1;
+}
+
+// Bytes allocated with malloc and not freed yet, summed over all arenas, or
+// -1 without glibc. The executor and DDS threads allocate from arenas of
+// their own, so it's read from the totals of malloc_info(): the arenas'
+// memory less their free chunks, plus the mmapped chunks.
+inline int64_t heap_in_use() {
+#if defined(__GLIBC__)
+  char* buffer = nullptr;
+  size_t size = 0;
+  FILE* out = open_memstream(&buffer, &size);
+  if (!out) {
+    return -1;
+  }
+  int error = malloc_info(0, out);
+  fclose(out);
+  std::string xml(buffer, size);
+  free(buffer);
+  // The totals over all arenas follow the last arena's <heap> element.
+  size_t totals = xml.rfind("</heap>");
+  if (error != 0 || totals == std::string::npos) {
+    return -1;
+  }
+  auto total = [&xml, totals](const std::string& element) -> int64_t {
+    size_t pos = xml.find(element, totals);
+    if (pos == std::string::npos) {
+      return 0;
+    }
+    pos = xml.find("size=\"", pos);
+    return pos == std::string::npos ? 0 : std::stoll(xml.substr(pos + 6));
+  };
+  return total("<system type=\"current\"") - total("<total type=\"fast\"") -
+         total("<total type=\"rest\"") + total("<total type=\"mmap\"");
+#else
+  return -1;
+#endif
+}
+
+struct MemorySample {
+  int64_t rss_kb;
+  // Proportional set size: RSS with shared pages split between the processes
+  // mapping them, so it adds up across processes.
+  int64_t pss_kb;
+  int64_t heap_kb;
+  int64_t threads;
+
+  static MemorySample now() {
+    int64_t heap = heap_in_use();
+    return MemorySample{proc_status_kb("VmRSS"),
+                        proc_status_kb("Pss", "/proc/self/smaps_rollup"),
+                        heap < 0 ? -1 : heap / 1024, proc_status_kb("Threads")};
+  }
+};
+
+// Samples RSS, PSS, heap and thread count of this process over the run.
+// The first sample is the baseline. Construct it before the benchmark's
+// nodes or servers are created, so the growth from the baseline to the end
+// of the run, divided by the number of nodes, is the memory per node. It is
+// also given in multiples of the payload size, i.e. how many payloads each
+// node holds on to.
+//
+//   --memmon                 enable the sampler
+//   --memmon-period-ms=100   sample period
+class MemorySampler {
+ public:
+  MemorySampler(std::chrono::milliseconds period, int nodes, int64_t payload_bytes)
+      : period_(period), nodes_(nodes), payload_bytes_(payload_bytes) {
+    baseline_ = MemorySample::now();
+    start_ = std::chrono::steady_clock::now();
+    thread_ = std::thread([this]() { run(); });
+    // Don't count the sampler's own thread.
+    baseline_.threads++;
+    add_report_section([this](std::ostream& out) { print(out); });
+  }
+
+  // Creates a sampler if --memmon is set, otherwise returns nullptr.
+  static std::unique_ptr<MemorySampler> from_flags(const Flags& flags, int nodes,
+                                                   int64_t payload_bytes) {
+    if (!flags.get_bool("memmon")) {
+      return nullptr;
+    }
+    return std::make_unique<MemorySampler>(
+        std::chrono::milliseconds(flags.get_int("memmon-period-ms", 100)), nodes, payload_bytes);
+  }
+
+  ~MemorySampler() { stop(); }
+
+  // Stops sampling and takes the final sample. Safe to call more than once.
+  void stop() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (stopped_) {
+        return;
+      }
+      stopped_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+    end_ = MemorySample::now();
+    add(end_);
+  }
+
+  void print(std::ostream& out) {
+    stop();
+    double seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+    out << "Memory over " << static_cast<int64_t>(seconds) << "s, " << samples_
+        << " samples, avg/peak/end (baseline before setup):\n";
+    auto row = [&](const char* name, int64_t sum, int64_t peak, int64_t end, int64_t baseline,
+                   const char* unit) {
+      if (end < 0) {
+        out << "  " << name << " n/a\n";
+        return;
+      }
+      out << "  " << name << " " << sum / samples_ << "/" << peak << "/" << end << unit << " ("
+          << baseline << unit << ")\n";
+    };
+    row("RSS", sum_.rss_kb, peak_.rss_kb, end_.rss_kb, baseline_.rss_kb, " kB");
+    row("PSS", sum_.pss_kb, peak_.pss_kb, end_.pss_kb, baseline_.pss_kb, " kB");
+    row("heap", sum_.heap_kb, peak_.heap_kb, end_.heap_kb, baseline_.heap_kb, " kB");
+    row("threads", sum_.threads, peak_.threads, end_.threads, baseline_.threads, "");
+
+    if (nodes_ > 0) {
+      auto per_node = [this](int64_t end, int64_t baseline) {
+        return end < 0 ? 0 : (end - baseline) / nodes_;
+      };
+      int64_t rss_per_node = per_node(end_.rss_kb, baseline_.rss_kb);
+      out << "Per node (" << nodes_ << " nodes): RSS " << rss_per_node << " kB, PSS "
+          << per_node(end_.pss_kb, baseline_.pss_kb) << " kB, heap "
+          << per_node(end_.heap_kb, baseline_.heap_kb) << " kB, threads "
+          << static_cast<double>(end_.threads - baseline_.threads) / nodes_;
+      if (payload_bytes_ > 0) {
+        out << ", RSS " << static_cast<double>(rss_per_node) * 1024 / payload_bytes_
+            << " payloads of " << payload_bytes_ << " bytes";
+      }
+      out << "\n";
+    }
+    out << "\n";
+  }
+
+ private:
+  void add(const MemorySample& s) {
+    samples_++;
+    sum_.rss_kb += s.rss_kb;
+    sum_.pss_kb += s.pss_kb;
+    sum_.heap_kb += s.heap_kb;
+    sum_.threads += s.threads;
+    peak_.rss_kb = std::max(peak_.rss_kb, s.rss_kb);
+    peak_.pss_kb = std::max(peak_.pss_kb, s.pss_kb);
+    peak_.heap_kb = std::max(peak_.heap_kb, s.heap_kb);
+    peak_.threads = std::max(peak_.threads, s.threads);
+  }
+
+  void run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopped_) {
+      add(MemorySample::now());
+      cv_.wait_for(lock, period_, [this]() { return stopped_; });
+    }
+  }
+
+  std::chrono::milliseconds period_;
+  int nodes_;
+  int64_t payload_bytes_;
+  std::chrono::steady_clock::time_point start_;
+  MemorySample baseline_;
+  MemorySample end_{-1, -1, -1, -1};
+  MemorySample sum_{0, 0, 0, 0};
+  MemorySample peak_{0, 0, 0, 0};
+  int64_t samples_ = 0;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stopped_ = false;
+  std::thread thread_;
+};
+
+}  // namespace benchcore
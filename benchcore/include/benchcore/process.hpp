@@ -0,0 +1,143 @@
+#pragma once
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <regex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace benchcore {
+
+using Environment = std::vector<std::pair<std::string, std::string>>;
+
+// Starts argv[0] with argv and env set on top of this process's environment.
+// If stdout_fd is valid, the child's stdout and stderr go there, otherwise to
+// /dev/null.
+inline pid_t start_process(const std::vector<std::string>& argv, const Environment& env = {},
+                           int stdout_fd = -1) {
+  pid_t pid = fork();
+  if (pid != 0) {
+    return pid;
+  }
+  int out = stdout_fd >= 0 ? stdout_fd : open("/dev/null", O_WRONLY);
+  dup2(out, STDOUT_FILENO);
+  dup2(out, STDERR_FILENO);
+  for (const auto& [name, value] : env) {
+    setenv(name.c_str(), value.c_str(), 1);
+  }
+  std::vector<char*> args;
+  for (const std::string& arg : argv) {
+    args.push_back(const_cast<char*>(arg.c_str()));
+  }
+  args.push_back(nullptr);
+  execv(args[0], args.data());
+  perror("execv");
+  _exit(127);
+}
+
+// Stops a process started with start_process(), with SIGINT first so ROS 2
+// processes shut down cleanly, then SIGKILL.
+inline void stop_process(pid_t pid,
+                         std::chrono::milliseconds grace = std::chrono::milliseconds(2000)) {
+  kill(pid, SIGINT);
+  auto deadline = std::chrono::steady_clock::now() + grace;
+  while (std::chrono::steady_clock::now() < deadline) {
+    if (waitpid(pid, nullptr, WNOHANG) == pid) {
+      return;
+    }
+    usleep(10000);
+  }
+  kill(pid, SIGKILL);
+  waitpid(pid, nullptr, 0);
+}
+
+struct ProcessResult {
+  bool timed_out = false;
+  int exit_code = -1;
+  std::string output;
+};
+
+// Runs a process to completion, or until timeout, and collects its output.
+inline ProcessResult run_process(const std::vector<std::string>& argv, const Environment& env,
+                                 std::chrono::seconds timeout) {
+  ProcessResult result;
+  int fds[2];
+  if (pipe2(fds, O_CLOEXEC) != 0) {
+    perror("pipe2");
+    return result;
+  }
+  pid_t pid = start_process(argv, env, fds[1]);
+  close(fds[1]);
+  auto deadline = std::chrono::steady_clock::now() + timeout;
+  while (true) {
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+        deadline - std::chrono::steady_clock::now());
+    if (left.count() <= 0) {
+      result.timed_out = true;
+      break;
+    }
+    pollfd pfd{fds[0], POLLIN, 0};
+    if (poll(&pfd, 1, static_cast<int>(left.count())) <= 0) {
+      continue;
+    }
+    char buf[4096];
+    ssize_t n = read(fds[0], buf, sizeof(buf));
+    if (n <= 0) {
+      break;
+    }
+    result.output.append(buf, n);
+  }
+  close(fds[0]);
+  if (result.timed_out) {
+    stop_process(pid);
+    return result;
+  }
+  int status = 0;
+  waitpid(pid, &status, 0);
+  result.exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+  return result;
+}
+
+// The per-hop latency a benchmark run printed with print_latency_stats(), or
+// why there is none: "timeout", or "exit N" for a run that ended without
+// stats.
+struct LatencyStats {
+  std::string error;
+  int64_t p50_us = 0;
+  int64_t p90_us = 0;
+
+  bool ok() const { return error.empty(); }
+  // The P50 or P90 for a table cell, or the error.
+  std::string p50_cell() const { return ok() ? std::to_string(p50_us) : error; }
+  std::string p90_cell() const { return ok() ? std::to_string(p90_us) : error; }
+};
+
+// Picks the first "P50 = Xus, P90 = Yus" line of a run's output.
+inline LatencyStats parse_latency_stats(const ProcessResult& run) {
+  static const std::regex stats_re("P50 = (\\d+)us, P90 = (\\d+)us");
+  std::smatch m;
+  if (std::regex_search(run.output, m, stats_re)) {
+    return LatencyStats{"", std::stoll(m[1]), std::stoll(m[2])};
+  }
+  if (run.timed_out) {
+    return LatencyStats{"timeout"};
+  }
+  return LatencyStats{"exit " + std::to_string(run.exit_code)};
+}
+
+// The first group of `re` in a run's output, or "-".
+inline std::string find_in_output(const ProcessResult& run, const std::regex& re) {
+  std::smatch m;
+  return std::regex_search(run.output, m, re) ? m[1].str() : "-";
+}
+
+}  // namespace benchcore
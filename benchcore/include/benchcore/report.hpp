@@ -0,0 +1,37 @@
+#pragma once
+
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace benchcore {
+
+// Extra report sections, printed by the sinks right after the latency stats.
+// Optional analysis modes register a section when they are enabled, so the
+// sinks don't need to know which modes are active.
+using ReportSection = std::function<void(std::ostream&)>;
+
+inline std::vector<ReportSection>& report_sections() {
+  static std::vector<ReportSection> sections;
+  return sections;
+}
+
+inline std::mutex& report_mutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+inline void add_report_section(ReportSection section) {
+  std::lock_guard<std::mutex> lock(report_mutex());
+  report_sections().push_back(std::move(section));
+}
+
+inline void print_report_sections(std::ostream& out) {
+  std::lock_guard<std::mutex> lock(report_mutex());
+  for (const auto& section : report_sections()) {
+    section(out);
+  }
+}
+
+}  // namespace benchcore
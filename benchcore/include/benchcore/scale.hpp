@@ -0,0 +1,153 @@
+#pragma once
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <regex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "benchcore/flags.hpp"
+#include "benchcore/memory.hpp"
+#include "benchcore/process.hpp"
+#include "benchcore/report.hpp"
+#include "benchcore/sweep.hpp"
+
+namespace benchcore {
+
+// Times the startup phases of a benchmark, e.g. node creation, discovery and
+// the first message at the sink, from construction on. Each phase is
+// reported once, the first time it's marked, with the thread count at the
+// end of the run.
+class StartupReport {
+ public:
+  explicit StartupReport(int nodes) : nodes_(nodes), start_(std::chrono::steady_clock::now()) {
+    add_report_section([this](std::ostream& out) { print(out); });
+  }
+
+  void mark(const std::string& phase) {
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& [name, time] : phases_) {
+      if (name == phase) {
+        return;
+      }
+    }
+    phases_.emplace_back(phase, now);
+  }
+
+  void print(std::ostream& out) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    out << "Startup with " << nodes_ << " nodes:\n";
+    auto previous = start_;
+    for (const auto& [name, time] : phases_) {
+      out << "  " << name << ": " << ms(time - start_) << " ms (+" << ms(time - previous)
+          << " ms)\n";
+      previous = time;
+    }
+    out << "Threads: " << proc_status_kb("Threads") << "\n\n";
+  }
+
+ private:
+  static int64_t ms(std::chrono::steady_clock::duration d) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(d).count();
+  }
+
+  int nodes_;
+  std::chrono::steady_clock::time_point start_;
+  std::mutex mutex_;
+  std::vector<std::pair<std::string, std::chrono::steady_clock::time_point>> phases_;
+};
+
+// Runs fn(i) for i in [0, count) on --create-threads threads, 1 by default.
+// Threads take every threads-th index, so with one thread it's in order.
+inline void parallel_for(const Flags& flags, int count, const std::function<void(int)>& fn) {
+  int threads = std::max<int64_t>(1, flags.get_int("create-threads", 1));
+  if (threads == 1) {
+    for (int i = 0; i < count; ++i) {
+      fn(i);
+    }
+    return;
+  }
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back([t, threads, count, &fn]() {
+      for (int i = t; i < count; i += threads) {
+        fn(i);
+      }
+    });
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+// Thousands of servers need more file descriptors than the usual soft limit.
+inline void raise_fd_limit() {
+  rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+}
+
+// Runs this binary once per relay count in --scale-sweep=100,1000,5000 with
+// --relays=N and the other flags, and prints startup times, latency and
+// threads per count as a table.
+inline int run_scale_sweep(const Flags& flags) {
+  std::vector<std::string> counts = split(flags.get("scale-sweep"));
+  std::vector<SweepCase> cases;
+  for (const std::string& relays : counts) {
+    cases.push_back({"with " + relays + " relays", {"--relays=" + relays}});
+  }
+  std::vector<SweepRun> runs =
+      run_sweep(flags, {"--scale-sweep", "--relays"}, cases, std::chrono::seconds(600));
+
+  // Phase names in the order they first show up, and per run the phase
+  // times.
+  static const std::regex phase_re("  ([a-z ]+): (\\d+) ms \\(");
+  static const std::regex threads_re("Threads: (\\d+)");
+  std::vector<std::string> phases;
+  std::vector<std::map<std::string, std::string>> phase_times;
+  for (const SweepRun& run : runs) {
+    const std::string& output = run.process.output;
+    std::map<std::string, std::string> times;
+    for (auto it = std::sregex_iterator(output.begin(), output.end(), phase_re);
+         it != std::sregex_iterator(); ++it) {
+      std::string name = (*it)[1];
+      if (std::find(phases.begin(), phases.end(), name) == phases.end()) {
+        phases.push_back(name);
+      }
+      times[name] = (*it)[2];
+    }
+    phase_times.push_back(std::move(times));
+  }
+
+  std::vector<std::string> columns = {"Relays"};
+  columns.insert(columns.end(), phases.begin(), phases.end());
+  columns.insert(columns.end(), {"P50", "P90", "Threads"});
+  std::vector<std::vector<std::string>> rows;
+  for (size_t i = 0; i < runs.size(); ++i) {
+    std::vector<std::string> row = {counts[i]};
+    for (const std::string& phase : phases) {
+      auto it = phase_times[i].find(phase);
+      row.push_back(it == phase_times[i].end() ? "-" : it->second);
+    }
+    row.insert(row.end(), {runs[i].stats.p50_cell(), runs[i].stats.p90_cell(),
+                           find_in_output(runs[i].process, threads_re)});
+    rows.push_back(std::move(row));
+  }
+  print_sweep_table(std::cout, "Scale sweep, phases in ms since start, latency in us/hop:",
+                    columns, rows);
+  return 0;
+}
+
+}  // namespace benchcore
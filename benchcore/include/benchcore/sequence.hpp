@@ -0,0 +1,150 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#include "benchcore/report.hpp"
+
+namespace benchcore {
+
+// Tracks the msgids arriving at a sink, so loss, reordering and duplicates
+// show up next to the latency instead of as a hung or faster looking run.
+// A msgid above the highest one so far opens a gap of the msgids it skips.
+// Those arriving later count as reordered, the rest as lost. A gap is
+// detected when the message after it arrives, its time to detect is the
+// time since the message before it. With several chains delivering the same
+// msgids, e.g. pnode's --width, each chain is tracked on its own. Registers a
+// report section.
+class SequenceTracker {
+ public:
+  // msgids beyond this are counted as out of range rather than tracked. It's
+  // about three days of a soak at 1000Hz.
+  static constexpr int64_t kMaxTracked = 1 << 28;
+
+  explicit SequenceTracker(int64_t first_msgid = 0, int chains = 1)
+      : first_msgid_(first_msgid), chains_(std::max(1, chains)) {
+    add_report_section([this](std::ostream& out) { print(out); });
+  }
+
+  void add(int64_t msgid, int64_t now_ns, int chain = 0) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Chain& c = chains_[chain];
+    int64_t index = msgid - first_msgid_;
+    if (index < 0 || index >= kMaxTracked) {
+      c.out_of_range++;
+      return;
+    }
+    if (index >= static_cast<int64_t>(c.received.size())) {
+      c.received.resize(index + 1);
+    }
+    if (c.received[index]) {
+      c.duplicates++;
+      return;
+    }
+    c.received[index] = true;
+    c.unique++;
+    if (index < c.next) {
+      c.reordered++;
+      return;
+    }
+    if (index > c.next && c.unique > 1) {
+      c.gaps.push_back(Gap{c.next, index, now_ns - c.last_ns});
+    }
+    c.next = index + 1;
+    c.last_ns = now_ns;
+  }
+
+  // The distinct msgids a chain delivered, duplicates and out of range ones
+  // not counted.
+  int64_t received(int chain = 0) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return chains_[chain].unique;
+  }
+
+  void print(std::ostream& out) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Chain total;
+    std::vector<int64_t> detect_ns;
+    for (const Chain& c : chains_) {
+      total.unique += c.unique;
+      total.next += c.next;
+      total.reordered += c.reordered;
+      total.duplicates += c.duplicates;
+      total.out_of_range += c.out_of_range;
+      std::vector<int64_t> chain_detect_ns = c.detect_ns();
+      detect_ns.insert(detect_ns.end(), chain_detect_ns.begin(), chain_detect_ns.end());
+    }
+    out << "Sequence: ";
+    print_counts(out, total, detect_ns.size());
+    if (chains_.size() > 1) {
+      out << " over " << chains_.size() << " chains";
+    }
+    out << "\n";
+    if (!detect_ns.empty()) {
+      std::sort(detect_ns.begin(), detect_ns.end());
+      out << "Drops detected after: P50 " << detect_ns[detect_ns.size() / 2] / 1000
+          << "us, max " << detect_ns.back() / 1000 << "us\n";
+    }
+    // Only the chains that didn't deliver every message once and in order.
+    for (size_t i = 0; chains_.size() > 1 && i < chains_.size(); ++i) {
+      const Chain& c = chains_[i];
+      if (c.next > c.unique || c.reordered > 0 || c.duplicates > 0 || c.out_of_range > 0) {
+        out << "  chain " << i << ": ";
+        print_counts(out, c, c.detect_ns().size());
+        out << "\n";
+      }
+    }
+    out << "\n";
+  }
+
+ private:
+  // The msgid indices [begin, end) skipped when end arrived.
+  struct Gap {
+    int64_t begin;
+    int64_t end;
+    int64_t detect_ns;
+  };
+
+  struct Chain {
+    std::vector<bool> received;
+    // The index after the highest one received.
+    int64_t next = 0;
+    int64_t last_ns = 0;
+    int64_t unique = 0;
+    int64_t reordered = 0;
+    int64_t duplicates = 0;
+    int64_t out_of_range = 0;
+    std::vector<Gap> gaps;
+
+    // The times to detect the gaps with messages still missing.
+    std::vector<int64_t> detect_ns() const {
+      std::vector<int64_t> result;
+      for (const Gap& gap : gaps) {
+        if (std::count(received.begin() + gap.begin, received.begin() + gap.end, false) > 0) {
+          result.push_back(gap.detect_ns);
+        }
+      }
+      return result;
+    }
+  };
+
+  static void print_counts(std::ostream& out, const Chain& c, size_t lost_gaps) {
+    out << c.unique << " received, " << c.next - c.unique << " lost";
+    if (lost_gaps > 0) {
+      out << " in " << lost_gaps << " gaps";
+    }
+    out << ", " << c.reordered << " reordered, " << c.duplicates << " duplicates";
+    if (c.out_of_range > 0) {
+      out << ", " << c.out_of_range << " out of range";
+    }
+  }
+
+  int64_t first_msgid_;
+  std::mutex mutex_;
+  std::vector<Chain> chains_;
+};
+
+}  // namespace benchcore
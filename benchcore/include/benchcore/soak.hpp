@@ -0,0 +1,350 @@
+#pragma once
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchcore/flags.hpp"
+#include "benchcore/memory.hpp"
+#include "benchcore/report.hpp"
+
+namespace benchcore {
+
+// Whether to soak: run for --soak-minutes instead of kNumSamples messages.
+// Sources then send until the sink's SoakMonitor ends the run.
+inline bool soak_requested(const Flags& flags) { return flags.has("soak-minutes"); }
+
+// Per-hop latency of one window of a soak, with the memory at its end.
+struct SoakWindow {
+  int64_t elapsed_s = 0;
+  int64_t count = 0;
+  int64_t p50 = 0;
+  int64_t p99 = 0;
+  int64_t max = 0;
+  int64_t rss_kb = 0;
+  int64_t heap = 0;
+
+  static SoakWindow of(int64_t elapsed_s, std::vector<int64_t>& samples) {
+    SoakWindow window;
+    window.elapsed_s = elapsed_s;
+    window.count = samples.size();
+    if (!samples.empty()) {
+      std::sort(samples.begin(), samples.end());
+      window.p50 = samples[samples.size() / 2];
+      window.p99 = samples[samples.size() * 99 / 100];
+      window.max = samples.back();
+    }
+    window.rss_kb = proc_status_kb("VmRSS");
+    window.heap = heap_in_use();
+    return window;
+  }
+};
+
+// Long running latency monitoring, for drift, leaks and periodic stalls that
+// a 1000 message run doesn't show:
+//
+//   --soak-minutes=N      run N minutes, then report and exit. 0 runs until
+//                         killed.
+//   --soak-window-s=60    the long window. The short one is a second.
+//   --soak-file=path      appends a CSV line per long window.
+//   --soak-port=N         serves the Prometheus text format on
+//                         127.0.0.1:N, with the cumulative histogram and the
+//                         latest windows.
+//   --soak-trend-pct=20   flags P99 or RSS as rising when the last third of
+//                         the windows averages that much above the first.
+//   --soak-stall-us=N     flags a second as a stall when its max is above N,
+//                         by default 10 times the P50 of the first second
+//                         with messages.
+//
+// The sink calls add() with every message's per-hop latency.
+class SoakMonitor {
+ public:
+  // Upper bucket bounds of the cumulative histogram, in us.
+  static constexpr std::array<int64_t, 16> kBucketsUs = {
+      1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000, 20000, 50000, 100000};
+
+  static std::unique_ptr<SoakMonitor> from_flags(const Flags& flags) {
+    if (!soak_requested(flags)) {
+      return nullptr;
+    }
+    return std::make_unique<SoakMonitor>(flags);
+  }
+
+  explicit SoakMonitor(const Flags& flags)
+      : duration_(std::chrono::minutes(flags.get_int("soak-minutes", 0))),
+        window_s_(std::max<int64_t>(1, flags.get_int("soak-window-s", 60))),
+        trend_pct_(flags.get_double("soak-trend-pct", 20)),
+        stall_ns_(flags.get_int("soak-stall-us", 0) * 1000),
+        start_(std::chrono::steady_clock::now()) {
+    if (flags.has("soak-file")) {
+      file_.open(flags.get("soak-file"), std::ios::app);
+      if (!file_) {
+        throw std::invalid_argument("can't write --soak-file " + flags.get("soak-file"));
+      }
+      file_ << "elapsed_s,messages,p50_us,p99_us,max_us,rss_kb,heap_bytes,stalls" << std::endl;
+    }
+    if (flags.has("soak-port")) {
+      listen_fd_ = listen_on(flags.get_int("soak-port", 0));
+      server_ = std::thread([this]() { serve(); });
+    }
+    monitor_ = std::thread([this]() { run(); });
+  }
+
+  ~SoakMonitor() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    stopped_.notify_all();
+    monitor_.join();
+    if (server_.joinable()) {
+      server_.join();
+      close(listen_fd_);
+    }
+  }
+
+  void add(int64_t ns_per_hop) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    second_.push_back(ns_per_hop);
+    size_t bucket = std::lower_bound(kBucketsUs.begin(), kBucketsUs.end(),
+                                     (ns_per_hop + 999) / 1000) -
+                    kBucketsUs.begin();
+    buckets_[bucket]++;
+    sum_ns_ += ns_per_hop;
+    total_++;
+  }
+
+ private:
+  // Closes a window every second, a long one every window_s_, and ends the
+  // run after duration_. Only this thread changes the windows and stalls,
+  // so it reads them without the lock. The stats are computed outside of it
+  // not to hold up add().
+  void run() {
+    auto next = start_;
+    for (int64_t elapsed_s = 1;; ++elapsed_s) {
+      next += std::chrono::seconds(1);
+      std::vector<int64_t> samples;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (stopped_.wait_until(lock, next, [this]() { return stop_; })) {
+          return;
+        }
+        samples.swap(second_);
+      }
+      window_.insert(window_.end(), samples.begin(), samples.end());
+      SoakWindow second = SoakWindow::of(elapsed_s, samples);
+      bool long_window = elapsed_s % window_s_ == 0;
+      SoakWindow window;
+      if (long_window) {
+        window = SoakWindow::of(elapsed_s, window_);
+        window_.clear();
+      }
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        last_second_ = second;
+        // Seeded from the first short window, so the first long one is
+        // checked too.
+        if (stall_ns_ == 0 && second.count > 0) {
+          stall_ns_ = 10 * second.p50;
+        }
+        if (stall_ns_ > 0 && second.max > stall_ns_) {
+          stalls_.push_back(elapsed_s);
+        }
+        if (long_window) {
+          windows_.push_back(window);
+        }
+      }
+      if (long_window) {
+        report_window(window);
+      }
+      if (duration_.count() > 0 && std::chrono::seconds(elapsed_s) >= duration_) {
+        finish();
+      }
+    }
+  }
+
+  void report_window(const SoakWindow& window) {
+    std::cout << "Soak " << window.elapsed_s / 60 << "m" << window.elapsed_s % 60
+              << "s: " << window.count << " messages, p50 " << window.p50 / 1000 << "us, p99 "
+              << window.p99 / 1000 << "us, max " << window.max / 1000 << "us, RSS "
+              << window.rss_kb / 1024 << " MB, " << stalls_.size() << " stalls" << std::endl;
+    if (file_.is_open()) {
+      file_ << window.elapsed_s << "," << window.count << "," << window.p50 / 1000 << ","
+            << window.p99 / 1000 << "," << window.max / 1000 << "," << window.rss_kb << ","
+            << window.heap << "," << stalls_.size() << std::endl;
+    }
+  }
+
+  // Prints the trends and the other report sections, and exits.
+  void finish() {
+    int64_t total;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      total = total_;
+    }
+    std::cout << "\nSoak of " << duration_.count() / 60 << " minutes, " << total
+              << " messages in " << windows_.size() << " windows of " << window_s_ << "s\n";
+    print_trend("P99", [](const SoakWindow& w) { return w.p99 / 1000; }, "us");
+    print_trend("RSS", [](const SoakWindow& w) { return w.rss_kb / 1024; }, "MB");
+    std::cout << "Stalls: " << stalls_.size() << " seconds with a message over "
+              << stall_ns_ / 1000 << "us";
+    if (stalls_.size() > 1) {
+      std::vector<int64_t> gaps;
+      for (size_t i = 1; i < stalls_.size(); ++i) {
+        gaps.push_back(stalls_[i] - stalls_[i - 1]);
+      }
+      std::sort(gaps.begin(), gaps.end());
+      std::cout << ", median " << gaps[gaps.size() / 2] << "s apart";
+    }
+    std::cout << "\n\n";
+    print_report_sections(std::cout);
+    exit(0);
+  }
+
+  // Compares the first and the last third of the windows.
+  template <typename Value>
+  void print_trend(const char* name, Value value, const char* unit) {
+    size_t third = windows_.size() / 3;
+    if (third == 0) {
+      std::cout << name << " trend: needs 3 windows\n";
+      return;
+    }
+    double first = 0;
+    double last = 0;
+    for (size_t i = 0; i < third; ++i) {
+      first += value(windows_[i]);
+      last += value(windows_[windows_.size() - third + i]);
+    }
+    first /= third;
+    last /= third;
+    double pct = first > 0 ? 100 * (last - first) / first : 0;
+    std::cout << name << " trend: " << static_cast<int64_t>(first) << " -> "
+              << static_cast<int64_t>(last) << unit << " (" << (pct >= 0 ? "+" : "")
+              << static_cast<int64_t>(pct) << "%)" << (pct > trend_pct_ ? ", RISING" : "")
+              << "\n";
+  }
+
+  static int listen_on(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(fd, 4) != 0) {
+      perror("soak-port");
+      close(fd);
+      return -1;
+    }
+    return fd;
+  }
+
+  // Answers every request on the port with metrics(), one per connection.
+  void serve() {
+    while (listen_fd_ >= 0) {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stop_) {
+          return;
+        }
+      }
+      pollfd pfd{listen_fd_, POLLIN, 0};
+      if (poll(&pfd, 1, 200) <= 0) {
+        continue;
+      }
+      int fd = accept(listen_fd_, nullptr, nullptr);
+      if (fd < 0) {
+        continue;
+      }
+      char request[1024];
+      recv(fd, request, sizeof(request), 0);
+      std::string body = metrics();
+      std::string response = "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                             "Content-Length: " + std::to_string(body.size()) +
+                             "\r\nConnection: close\r\n\r\n" + body;
+      send(fd, response.data(), response.size(), MSG_NOSIGNAL);
+      close(fd);
+    }
+  }
+
+  std::string metrics() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::ostringstream out;
+    out << "# TYPE bench_hop_latency_seconds histogram\n";
+    int64_t cumulative = 0;
+    for (size_t i = 0; i < kBucketsUs.size(); ++i) {
+      cumulative += buckets_[i];
+      out << "bench_hop_latency_seconds_bucket{le=\"" << kBucketsUs[i] / 1e6 << "\"} "
+          << cumulative << "\n";
+    }
+    out << "bench_hop_latency_seconds_bucket{le=\"+Inf\"} " << total_ << "\n"
+        << "bench_hop_latency_seconds_sum " << sum_ns_ / 1e9 << "\n"
+        << "bench_hop_latency_seconds_count " << total_ << "\n";
+    out << "# TYPE bench_hop_latency_window_seconds gauge\n";
+    auto window_gauges = [&](const char* window, const SoakWindow& w) {
+      for (auto [quantile, ns] : {std::pair<const char*, int64_t>{"0.5", w.p50},
+                                  {"0.99", w.p99},
+                                  {"1", w.max}}) {
+        out << "bench_hop_latency_window_seconds{window=\"" << window << "\",quantile=\""
+            << quantile << "\"} " << ns / 1e9 << "\n";
+      }
+    };
+    window_gauges("1s", last_second_);
+    if (!windows_.empty()) {
+      window_gauges((std::to_string(window_s_) + "s").c_str(), windows_.back());
+    }
+    out << "# TYPE bench_rss_bytes gauge\n"
+        << "bench_rss_bytes " << last_second_.rss_kb * 1024 << "\n"
+        << "# TYPE bench_heap_bytes gauge\n"
+        << "bench_heap_bytes " << last_second_.heap << "\n"
+        << "# TYPE bench_stalls_total counter\n"
+        << "bench_stalls_total " << stalls_.size() << "\n";
+    return out.str();
+  }
+
+  std::chrono::seconds duration_;
+  int64_t window_s_;
+  double trend_pct_;
+  int64_t stall_ns_;
+  std::chrono::steady_clock::time_point start_;
+  std::ofstream file_;
+  int listen_fd_ = -1;
+
+  std::mutex mutex_;
+  std::condition_variable stopped_;
+  bool stop_ = false;
+  std::vector<int64_t> second_;
+  std::vector<int64_t> window_;
+  SoakWindow last_second_;
+  std::vector<SoakWindow> windows_;
+  std::vector<int64_t> stalls_;
+  std::array<int64_t, kBucketsUs.size() + 1> buckets_{};
+  int64_t sum_ns_ = 0;
+  int64_t total_ = 0;
+
+  std::thread monitor_;
+  std::thread server_;
+};
+
+}  // namespace benchcore
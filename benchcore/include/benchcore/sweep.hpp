@@ -0,0 +1,85 @@
+#pragma once
+
+#include <chrono>
+#include <iostream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "benchcore/flags.hpp"
+#include "benchcore/process.hpp"
+
+namespace benchcore {
+
+// One run of a sweep: a name for the progress output, and the flags it adds
+// to the ones the sweep was started with.
+struct SweepCase {
+  std::string name;
+  std::vector<std::string> args;
+};
+
+// A finished run: its output, and the latency stats parsed from it.
+struct SweepRun {
+  ProcessResult process;
+  LatencyStats stats;
+};
+
+// Runs this binary once per case, in order. Every run gets the flags this
+// process was started with, less those starting with "--sweep-" or any of
+// stripped_prefixes, then the case's own args, which win over the others.
+// Each run is stopped after --sweep-timeout seconds, default_timeout unless
+// given.
+inline std::vector<SweepRun> run_sweep(const Flags& flags,
+                                       const std::vector<std::string>& stripped_prefixes,
+                                       const std::vector<SweepCase>& cases,
+                                       std::chrono::seconds default_timeout) {
+  std::vector<std::string> base = {"/proc/self/exe"};
+  for (size_t i = 1; i < flags.args().size(); ++i) {
+    const std::string& arg = flags.args()[i];
+    bool stripped = arg.rfind("--sweep-", 0) == 0;
+    for (const std::string& prefix : stripped_prefixes) {
+      stripped = stripped || arg.rfind(prefix, 0) == 0;
+    }
+    if (!stripped) {
+      base.push_back(arg);
+    }
+  }
+  std::chrono::seconds timeout(flags.get_int("sweep-timeout", default_timeout.count()));
+
+  std::vector<SweepRun> runs;
+  for (const SweepCase& sweep_case : cases) {
+    std::vector<std::string> argv = base;
+    argv.insert(argv.end(), sweep_case.args.begin(), sweep_case.args.end());
+    std::cout << "Running " << sweep_case.name << "\n" << std::flush;
+    SweepRun run;
+    run.process = run_process(argv, {}, timeout);
+    run.stats = parse_latency_stats(run.process);
+    runs.push_back(std::move(run));
+  }
+  return runs;
+}
+
+// Prints a sweep's results as a markdown table, after a blank line and the
+// title.
+inline void print_sweep_table(std::ostream& out, const std::string& title,
+                              const std::vector<std::string>& columns,
+                              const std::vector<std::vector<std::string>>& rows) {
+  out << "\n" << title << "\n|";
+  for (const std::string& column : columns) {
+    out << " " << column << " |";
+  }
+  out << "\n|";
+  for (const std::string& column : columns) {
+    out << " " << std::string(column.size(), '-') << " |";
+  }
+  out << "\n";
+  for (const auto& row : rows) {
+    out << "|";
+    for (const std::string& cell : row) {
+      out << " " << cell << " |";
+    }
+    out << "\n";
+  }
+}
+
+}  // namespace benchcore
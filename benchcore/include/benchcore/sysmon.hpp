@@ -0,0 +1,190 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchcore/flags.hpp"
+
+namespace benchcore {
+
+// Reads a single integer from a sysfs file. Returns -1 if it can't be read.
+inline int64_t read_sysfs_int(const std::string& path) {
+  std::ifstream in(path);
+  int64_t value = -1;
+  if (!(in >> value)) {
+    return -1;
+  }
+  return value;
+}
+
+inline std::string read_sysfs_string(const std::string& path) {
+  std::ifstream in(path);
+  std::string value;
+  std::getline(in, value);
+  return value;
+}
+
+// Samples CPU frequency (cpufreq) and idle state residency (cpuidle) from
+// /sys while a benchmark runs. Frequency is polled every sample period, and
+// idle residency is the difference of the cumulative cpuidle counters between
+// start and stop. Either may be unavailable, e.g. in VMs and some containers.
+class CpuSampler {
+ public:
+  explicit CpuSampler(std::chrono::milliseconds period) : period_(period) {
+    for (int cpu = 0;; ++cpu) {
+      std::string dir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+      if (read_sysfs_int(dir + "/online") == 0) {
+        continue;
+      }
+      if (!std::ifstream(dir + "/topology/core_id")) {
+        break;
+      }
+      Cpu c;
+      c.index = cpu;
+      c.dir = dir;
+      for (int state = 0;; ++state) {
+        std::string state_dir = dir + "/cpuidle/state" + std::to_string(state);
+        std::string name = read_sysfs_string(state_dir + "/name");
+        if (name.empty()) {
+          break;
+        }
+        c.idle_states.push_back({name, state_dir, 0, 0, 0, 0});
+      }
+      cpus_.push_back(std::move(c));
+    }
+    start_ = std::chrono::steady_clock::now();
+    for (Cpu& cpu : cpus_) {
+      for (IdleState& state : cpu.idle_states) {
+        state.start_time_us = read_sysfs_int(state.dir + "/time");
+        state.start_usage = read_sysfs_int(state.dir + "/usage");
+      }
+    }
+    thread_ = std::thread([this]() { run(); });
+  }
+
+  // Creates a sampler if --sysmon or --load is set, otherwise returns
+  // nullptr. The sample period is --sysmon-period-ms, 100ms by default.
+  static std::unique_ptr<CpuSampler> from_flags(const Flags& flags) {
+    if (!flags.get_bool("sysmon") && !flags.has("load")) {
+      return nullptr;
+    }
+    return std::make_unique<CpuSampler>(
+        std::chrono::milliseconds(flags.get_int("sysmon-period-ms", 100)));
+  }
+
+  ~CpuSampler() { stop(); }
+
+  // Stops sampling and takes the final idle counter snapshot. Safe to call
+  // more than once.
+  void stop() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (stopped_) {
+        return;
+      }
+      stopped_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+    end_ = std::chrono::steady_clock::now();
+    for (Cpu& cpu : cpus_) {
+      for (IdleState& state : cpu.idle_states) {
+        state.end_time_us = read_sysfs_int(state.dir + "/time");
+        state.end_usage = read_sysfs_int(state.dir + "/usage");
+      }
+    }
+  }
+
+  void print(std::ostream& out) {
+    stop();
+    std::ios::fmtflags format(out.flags());
+    std::streamsize precision = out.precision();
+    double wall_us = std::chrono::duration<double, std::micro>(end_ - start_).count();
+    out << "CPU frequency and idle residency over " << static_cast<int64_t>(wall_us / 1e6)
+        << "s, " << samples_ << " samples:\n";
+    for (const Cpu& cpu : cpus_) {
+      out << "  cpu" << std::setw(3) << std::left << cpu.index << std::right;
+      if (cpu.freq_samples > 0) {
+        out << " MHz avg/min/max " << cpu.freq_sum_khz / cpu.freq_samples / 1000 << "/"
+            << cpu.freq_min_khz / 1000 << "/" << cpu.freq_max_khz / 1000;
+      } else {
+        out << " MHz n/a";
+      }
+      if (cpu.idle_states.empty()) {
+        out << ", idle n/a";
+      }
+      for (const IdleState& state : cpu.idle_states) {
+        if (state.start_time_us < 0 || state.end_time_us < 0) {
+          continue;
+        }
+        double residency = 100.0 * (state.end_time_us - state.start_time_us) / wall_us;
+        double entries_per_s = (state.end_usage - state.start_usage) / (wall_us / 1e6);
+        out << ", " << state.name << " " << std::fixed << std::setprecision(1) << residency
+            << "% " << std::setprecision(0) << entries_per_s << "/s";
+      }
+      out << "\n";
+    }
+    out.flags(format);
+    out.precision(precision);
+  }
+
+ private:
+  struct IdleState {
+    std::string name;
+    std::string dir;
+    int64_t start_time_us;
+    int64_t start_usage;
+    int64_t end_time_us;
+    int64_t end_usage;
+  };
+  struct Cpu {
+    int index = 0;
+    std::string dir;
+    std::vector<IdleState> idle_states;
+    int64_t freq_samples = 0;
+    int64_t freq_sum_khz = 0;
+    int64_t freq_min_khz = INT64_MAX;
+    int64_t freq_max_khz = 0;
+  };
+
+  void run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopped_) {
+      for (Cpu& cpu : cpus_) {
+        int64_t khz = read_sysfs_int(cpu.dir + "/cpufreq/scaling_cur_freq");
+        if (khz <= 0) {
+          continue;
+        }
+        cpu.freq_samples++;
+        cpu.freq_sum_khz += khz;
+        cpu.freq_min_khz = std::min(cpu.freq_min_khz, khz);
+        cpu.freq_max_khz = std::max(cpu.freq_max_khz, khz);
+      }
+      samples_++;
+      cv_.wait_for(lock, period_, [this]() { return stopped_; });
+    }
+  }
+
+  std::chrono::milliseconds period_;
+  std::vector<Cpu> cpus_;
+  std::chrono::steady_clock::time_point start_;
+  std::chrono::steady_clock::time_point end_;
+  int64_t samples_ = 0;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stopped_ = false;
+  std::thread thread_;
+};
+
+}  // namespace benchcore
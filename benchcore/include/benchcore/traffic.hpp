@@ -0,0 +1,211 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "benchcore/flags.hpp"
+#include "benchcore/report.hpp"
+
+namespace benchcore {
+
+// When a source sends, as the gaps between consecutive messages. The mean
+// gap is the source's usual period.
+//
+//   --traffic=uniform          one message per period, the default
+//   --traffic=poisson          exponential gaps, --traffic-seed=1
+//   --traffic=burst            --burst-size=8 messages --burst-spacing-us=0
+//                              apart, every --burst-period-ms (default
+//                              burst size times the period)
+//   --traffic=replay           gaps in us from --traffic-file, one per line,
+//                              looped
+//
+// A message that follows the previous one by less than --burst-gap-us,
+// default half the period, is in the same burst.
+class TrafficShape {
+ public:
+  enum class Kind { kUniform, kPoisson, kBurst, kReplay };
+
+  static TrafficShape from_flags(const Flags& flags, std::chrono::nanoseconds period) {
+    TrafficShape shape;
+    shape.period_ns_ = period.count();
+    std::string kind = flags.get("traffic", "uniform");
+    if (kind == "uniform") {
+      shape.kind_ = Kind::kUniform;
+    } else if (kind == "poisson") {
+      shape.kind_ = Kind::kPoisson;
+      shape.random_.seed(flags.get_int("traffic-seed", 1));
+    } else if (kind == "burst") {
+      shape.kind_ = Kind::kBurst;
+      shape.burst_size_ = std::max<int64_t>(1, flags.get_int("burst-size", 8));
+      shape.burst_spacing_ns_ = flags.get_int("burst-spacing-us", 0) * 1000;
+      shape.burst_period_ns_ =
+          flags.has("burst-period-ms")
+              ? static_cast<int64_t>(flags.get_double("burst-period-ms", 0) * 1e6)
+              : shape.burst_size_ * shape.period_ns_;
+    } else if (kind == "replay") {
+      shape.kind_ = Kind::kReplay;
+      shape.trace_ = read_trace(flags.get("traffic-file"));
+    } else {
+      throw std::invalid_argument("unknown traffic: " + kind);
+    }
+    shape.burst_gap_ns_ = flags.has("burst-gap-us") ? flags.get_int("burst-gap-us", 0) * 1000
+                                                    : shape.period_ns_ / 2;
+    return shape;
+  }
+
+  bool uniform() const { return kind_ == Kind::kUniform; }
+  int64_t burst_gap_ns() const { return burst_gap_ns_; }
+
+  // The gap before the next message.
+  int64_t next_gap_ns() {
+    switch (kind_) {
+      case Kind::kUniform:
+        return period_ns_;
+      case Kind::kPoisson:
+        return static_cast<int64_t>(
+            std::exponential_distribution<double>(1.0 / period_ns_)(random_));
+      case Kind::kBurst: {
+        int64_t in_burst = index_++ % burst_size_;
+        if (in_burst < burst_size_ - 1) {
+          return burst_spacing_ns_;
+        }
+        return std::max<int64_t>(0, burst_period_ns_ - (burst_size_ - 1) * burst_spacing_ns_);
+      }
+      case Kind::kReplay:
+        return trace_[index_++ % trace_.size()];
+    }
+    return period_ns_;
+  }
+
+ private:
+  static std::vector<int64_t> read_trace(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+      throw std::invalid_argument("can't read --traffic-file " + path);
+    }
+    std::vector<int64_t> gaps;
+    std::string line;
+    while (std::getline(in, line)) {
+      if (!line.empty() && line[0] != '#') {
+        gaps.push_back(static_cast<int64_t>(std::stod(line) * 1000));
+      }
+    }
+    if (gaps.empty()) {
+      throw std::invalid_argument("no gaps in --traffic-file " + path);
+    }
+    return gaps;
+  }
+
+  Kind kind_ = Kind::kUniform;
+  int64_t period_ns_ = 0;
+  int64_t burst_gap_ns_ = 0;
+  int64_t burst_size_ = 1;
+  int64_t burst_spacing_ns_ = 0;
+  int64_t burst_period_ns_ = 0;
+  std::vector<int64_t> trace_;
+  int64_t index_ = 0;
+  std::mt19937_64 random_;
+};
+
+// Paces a source loop: call wait() after each send. Uniform traffic keeps
+// the sources' original sleep of one period after each send. The other
+// shapes follow an absolute schedule from the first send on, so the time
+// spent sending doesn't stretch the bursts.
+class Pacer {
+ public:
+  Pacer(TrafficShape shape, std::chrono::nanoseconds period)
+      : shape_(std::move(shape)), period_(period) {}
+  Pacer(const Flags& flags, std::chrono::nanoseconds period)
+      : Pacer(TrafficShape::from_flags(flags, period), period) {}
+
+  bool uniform() const { return shape_.uniform(); }
+  // When the last wait() was meant to end, for shapes other than uniform.
+  std::chrono::steady_clock::time_point scheduled() const { return next_; }
+
+  void wait() {
+    if (shape_.uniform()) {
+      std::this_thread::sleep_for(period_);
+      return;
+    }
+    if (!started_) {
+      next_ = std::chrono::steady_clock::now();
+      started_ = true;
+    }
+    next_ += std::chrono::nanoseconds(shape_.next_gap_ns());
+    std::this_thread::sleep_until(next_);
+  }
+
+ private:
+  TrafficShape shape_;
+  std::chrono::nanoseconds period_;
+  bool started_ = false;
+  std::chrono::steady_clock::time_point next_;
+};
+
+// Latency per position in a burst, for the sink. It replays the source's
+// traffic shape from the same flags to tell each message's position from its
+// msgid, so it also works across processes. Registers a report section
+// unless the traffic is uniform.
+class BurstStats {
+ public:
+  // Positions from this one on are reported together.
+  static constexpr int kMaxPosition = 16;
+
+  explicit BurstStats(TrafficShape shape, int64_t first_msgid = 0)
+      : shape_(std::move(shape)), first_msgid_(first_msgid) {
+    if (!shape_.uniform()) {
+      add_report_section([this](std::ostream& out) { print(out); });
+    }
+  }
+  BurstStats(const Flags& flags, std::chrono::nanoseconds period)
+      : BurstStats(TrafficShape::from_flags(flags, period)) {}
+
+  void add(int64_t msgid, int64_t nanosec_per_hop) {
+    if (shape_.uniform() || msgid < first_msgid_) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t index = msgid - first_msgid_;
+    while (positions_.size() <= index) {
+      int position = 0;
+      if (!positions_.empty() && shape_.next_gap_ns() < shape_.burst_gap_ns()) {
+        position = std::min(positions_.back() + 1, kMaxPosition);
+      }
+      positions_.push_back(position);
+    }
+    data_[positions_[index]].push_back(nanosec_per_hop);
+  }
+
+  void print(std::ostream& out) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    out << "Latency by burst position, ns/hop:\n";
+    for (auto& [position, samples] : data_) {
+      std::sort(samples.begin(), samples.end());
+      out << "  " << position << (position == kMaxPosition ? "+" : "")
+          << ": P50 = " << samples[samples.size() / 2] / 1000
+          << "us, P90 = " << samples[samples.size() * 9 / 10] / 1000 << "us, "
+          << samples.size() << " samples\n";
+    }
+    out << "\n";
+  }
+
+ private:
+  TrafficShape shape_;
+  int64_t first_msgid_;
+  std::mutex mutex_;
+  std::vector<int> positions_;
+  std::map<int, std::vector<int64_t>> data_;
+};
+
+}  // namespace benchcore
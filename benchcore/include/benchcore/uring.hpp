@@ -0,0 +1,257 @@
+#pragma once
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+#include "benchcore/flags.hpp"
+
+namespace benchcore {
+
+// io_uring settings of the --transport=uring paths:
+//   --uring-sqpoll        a kernel thread polls the submission queues, so
+//                         submitting takes no syscall. All rings share one.
+//   --uring-spin-us=50    with --uring-sqpoll, how long to spin for a
+//                         completion before waiting for it in the kernel.
+struct UringOptions {
+  bool sqpoll = false;
+  std::chrono::microseconds spin{50};
+
+  static UringOptions from_flags(const Flags& flags) {
+    UringOptions options;
+    options.sqpoll = flags.get_bool("uring-sqpoll");
+    options.spin = std::chrono::microseconds(flags.get_int("uring-spin-us", 50));
+    return options;
+  }
+};
+
+// A minimal io_uring over the raw syscalls, so it needs no liburing: one
+// operation in flight at a time, as a blocking call. Without SQPOLL each
+// operation is one io_uring_enter() that submits and waits. Throws
+// std::runtime_error if the kernel has no io_uring.
+class Uring {
+ public:
+  static constexpr unsigned kEntries = 4;
+
+  explicit Uring(const UringOptions& options) : options_(options) {
+    io_uring_params params{};
+    if (options_.sqpoll) {
+      params.flags = IORING_SETUP_SQPOLL;
+      params.sq_thread_idle = 1000;
+      std::lock_guard<std::mutex> lock(sqpoll_mutex());
+      int& shared = sqpoll_ring();
+      if (shared >= 0) {
+        params.flags |= IORING_SETUP_ATTACH_WQ;
+        params.wq_fd = shared;
+      }
+      fd_ = setup(params);
+      if (fd_ < 0 && shared >= 0) {
+        // The first ring is gone, this one takes over the polling thread.
+        params = io_uring_params{};
+        params.flags = IORING_SETUP_SQPOLL;
+        params.sq_thread_idle = 1000;
+        fd_ = setup(params);
+      }
+      if (fd_ >= 0 && !(params.flags & IORING_SETUP_ATTACH_WQ)) {
+        shared = fd_;
+      }
+    } else {
+      fd_ = setup(params);
+    }
+    if (fd_ < 0) {
+      throw std::runtime_error(std::string("io_uring_setup: ") + strerror(errno));
+    }
+    try {
+      map_rings(params);
+    } catch (...) {
+      release();
+      throw;
+    }
+  }
+
+  ~Uring() { release(); }
+
+  Uring(const Uring&) = delete;
+  Uring& operator=(const Uring&) = delete;
+
+  // Registers buffers for read() and write() with their fixed_index.
+  // Returns 0, or -errno if the kernel refused, e.g. ENOMEM over
+  // RLIMIT_MEMLOCK.
+  int register_buffers(const iovec* buffers, unsigned count) {
+    if (syscall(__NR_io_uring_register, fd_, IORING_REGISTER_BUFFERS, buffers, count) != 0) {
+      return -errno;
+    }
+    return 0;
+  }
+
+  // The operations return what the syscall would, or -errno.
+  int read(int fd, void* buffer, size_t size, int fixed_index = -1) {
+    return run(rw_sqe(fixed_index >= 0 ? IORING_OP_READ_FIXED : IORING_OP_READ, fd, buffer, size,
+                      fixed_index));
+  }
+  int write(int fd, const void* buffer, size_t size, int fixed_index = -1) {
+    return run(rw_sqe(fixed_index >= 0 ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE, fd, buffer,
+                      size, fixed_index));
+  }
+  int accept(int fd) {
+    io_uring_sqe sqe{};
+    sqe.opcode = IORING_OP_ACCEPT;
+    sqe.fd = fd;
+    return run(sqe);
+  }
+
+ private:
+  static int setup(io_uring_params& params) {
+    return syscall(__NR_io_uring_setup, kEntries, &params);
+  }
+  static int enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0);
+  }
+  // The ring whose SQPOLL thread the others attach to, or -1.
+  static int& sqpoll_ring() {
+    static int fd = -1;
+    return fd;
+  }
+  static std::mutex& sqpoll_mutex() {
+    static std::mutex mutex;
+    return mutex;
+  }
+
+  // Unmaps what map_rings() mapped, also if it failed halfway, and closes
+  // the ring.
+  void release() {
+    if (options_.sqpoll) {
+      std::lock_guard<std::mutex> lock(sqpoll_mutex());
+      if (sqpoll_ring() == fd_) {
+        sqpoll_ring() = -1;
+      }
+    }
+    if (sqes_) {
+      munmap(sqes_, sqes_size_);
+    }
+    if (cq_ptr_ && cq_ptr_ != sq_ptr_) {
+      munmap(cq_ptr_, cq_size_);
+    }
+    if (sq_ptr_) {
+      munmap(sq_ptr_, sq_size_);
+    }
+    close(fd_);
+  }
+
+  static io_uring_sqe rw_sqe(uint8_t opcode, int fd, const void* buffer, size_t size,
+                             int fixed_index) {
+    io_uring_sqe sqe{};
+    sqe.opcode = opcode;
+    sqe.fd = fd;
+    sqe.addr = reinterpret_cast<uint64_t>(buffer);
+    sqe.len = size;
+    if (fixed_index >= 0) {
+      sqe.buf_index = fixed_index;
+    }
+    return sqe;
+  }
+
+  void map_rings(const io_uring_params& params) {
+    sq_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single) {
+      sq_size_ = cq_size_ = std::max(sq_size_, cq_size_);
+    }
+    sq_ptr_ = map(sq_size_, IORING_OFF_SQ_RING);
+    cq_ptr_ = single ? sq_ptr_ : map(cq_size_, IORING_OFF_CQ_RING);
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = static_cast<io_uring_sqe*>(map(sqes_size_, IORING_OFF_SQES));
+
+    char* sq = static_cast<char*>(sq_ptr_);
+    sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_flags_ = reinterpret_cast<unsigned*>(sq + params.sq_off.flags);
+    sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    char* cq = static_cast<char*>(cq_ptr_);
+    cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+  }
+
+  void* map(size_t size, off_t offset) {
+    void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, offset);
+    if (ptr == MAP_FAILED) {
+      throw std::runtime_error(std::string("io_uring mmap: ") + strerror(errno));
+    }
+    return ptr;
+  }
+
+  // Submits one operation and returns its result once it completed.
+  int run(const io_uring_sqe& sqe) {
+    unsigned tail = *sq_tail_;
+    unsigned index = tail & sq_mask_;
+    sqes_[index] = sqe;
+    sq_array_[index] = index;
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+
+    if (options_.sqpoll) {
+      // The polling thread may have gone to sleep after its idle time.
+      __atomic_thread_fence(__ATOMIC_SEQ_CST);
+      if (__atomic_load_n(sq_flags_, __ATOMIC_RELAXED) & IORING_SQ_NEED_WAKEUP) {
+        enter(fd_, 0, 0, IORING_ENTER_SQ_WAKEUP);
+      }
+      auto deadline = std::chrono::steady_clock::now() + options_.spin;
+      while (!completed() && std::chrono::steady_clock::now() < deadline) {
+      }
+      while (!completed()) {
+        enter(fd_, 0, 1, IORING_ENTER_GETEVENTS);
+      }
+    } else {
+      int submitted = enter(fd_, 1, 1, IORING_ENTER_GETEVENTS);
+      while (submitted < 0 && errno == EINTR) {
+        submitted = enter(fd_, 0, 1, IORING_ENTER_GETEVENTS);
+      }
+      if (submitted < 0) {
+        return -errno;
+      }
+      while (!completed()) {
+        enter(fd_, 0, 1, IORING_ENTER_GETEVENTS);
+      }
+    }
+    unsigned head = *cq_head_;
+    int result = cqes_[head & cq_mask_].res;
+    __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+    return result;
+  }
+
+  bool completed() const {
+    return __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE) != *cq_head_;
+  }
+
+  UringOptions options_;
+  int fd_ = -1;
+  void* sq_ptr_ = nullptr;
+  void* cq_ptr_ = nullptr;
+  size_t sq_size_ = 0;
+  size_t cq_size_ = 0;
+  size_t sqes_size_ = 0;
+  io_uring_sqe* sqes_ = nullptr;
+  unsigned* sq_tail_ = nullptr;
+  unsigned sq_mask_ = 0;
+  unsigned* sq_flags_ = nullptr;
+  unsigned* sq_array_ = nullptr;
+  unsigned* cq_head_ = nullptr;
+  unsigned* cq_tail_ = nullptr;
+  unsigned cq_mask_ = 0;
+  io_uring_cqe* cqes_ = nullptr;
+};
+
+}  // namespace benchcore
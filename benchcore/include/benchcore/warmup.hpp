@@ -0,0 +1,130 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "benchcore/clock.hpp"
+#include "benchcore/flags.hpp"
+#include "benchcore/report.hpp"
+
+namespace benchcore {
+
+// Drops a sink's first messages from the stats. They carry discovery
+// settling, connection setup and cold caches and page faults, and at 10Hz
+// they are a large part of the 1000 samples. --warmup picks how many:
+//   N     the first N messages
+//   auto  until the latency is steady: the median of a window of
+//         --warmup-window (default 50) messages is within
+//         --warmup-tolerance (default 0.1) of the previous window's, and at
+//         most --warmup-max (default 500) messages
+// The sources send extra_messages() on top of the usual ones, so the stats
+// still have as many samples. The dropped messages are reported as the cold
+// start. Registers a report section.
+class Warmup {
+ public:
+  // Returns nullptr without --warmup. `name` tells the reports apart when a
+  // benchmark has two sinks, e.g. psrv's round trips.
+  static std::unique_ptr<Warmup> from_flags(const Flags& flags, const std::string& name = "") {
+    if (extra_messages(flags) == 0) {
+      return nullptr;
+    }
+    return std::make_unique<Warmup>(flags, name);
+  }
+
+  // The most messages a Warmup drops with these flags, 0 without --warmup.
+  static int64_t extra_messages(const Flags& flags) {
+    if (!flags.has("warmup")) {
+      return 0;
+    }
+    std::string warmup = flags.get("warmup");
+    if (warmup == "auto" || warmup == "true") {
+      return std::max<int64_t>(1, flags.get_int("warmup-max", 500));
+    }
+    return std::max<int64_t>(0, std::stoll(warmup));
+  }
+
+  Warmup(const Flags& flags, const std::string& name)
+      : name_(name),
+        automatic_(flags.get("warmup") == "auto" || flags.get("warmup") == "true"),
+        max_(extra_messages(flags)),
+        window_(std::max<int64_t>(2, flags.get_int("warmup-window", 50))),
+        tolerance_(flags.get_double("warmup-tolerance", 0.1)) {
+    cold_.reserve(max_);
+    add_report_section([this](std::ostream& out) { print(out); });
+  }
+
+  // Returns true while the message is part of the warmup, for the caller to
+  // drop it. Calls must not overlap, as with the sinks' deliveries.
+  bool add(int64_t nanosec_per_hop) {
+    if (done_) {
+      return false;
+    }
+    int64_t now = now_ns();
+    if (cold_.empty()) {
+      first_ns_ = now;
+    }
+    last_ns_ = now;
+    cold_.push_back(nanosec_per_hop);
+    int64_t count = cold_.size();
+    if (automatic_ && count % window_ == 0) {
+      std::vector<int64_t> window(cold_.end() - window_, cold_.end());
+      std::nth_element(window.begin(), window.begin() + window_ / 2, window.end());
+      int64_t median = window[window_ / 2];
+      if (previous_median_ > 0 &&
+          std::abs(median - previous_median_) <= tolerance_ * previous_median_) {
+        steady_ = true;
+        done_ = true;
+      }
+      previous_median_ = median;
+    }
+    if (count >= max_) {
+      done_ = true;
+    }
+    return true;
+  }
+
+  // The messages dropped so far.
+  int64_t messages() const { return cold_.size(); }
+
+  void print(std::ostream& out) {
+    out << "Warmup" << (name_.empty() ? "" : " of " + name_) << ": ";
+    if (cold_.empty()) {
+      out << "no messages\n\n";
+      return;
+    }
+    out << cold_.size() << " messages dropped over " << (last_ns_ - first_ns_) / 1000000
+        << " ms";
+    if (automatic_) {
+      out << (steady_ ? ", steady" : ", not steady after --warmup-max");
+    }
+    std::vector<int64_t> sorted = cold_;
+    std::sort(sorted.begin(), sorted.end());
+    out << "\n  cold start: first " << cold_.front() / 1000 << "us/hop, P50 "
+        << sorted[sorted.size() / 2] / 1000 << "us/hop, max " << sorted.back() / 1000
+        << "us/hop";
+    if (previous_median_ > 0) {
+      out << ", last window's P50 " << previous_median_ / 1000 << "us/hop";
+    }
+    out << "\n\n";
+  }
+
+ private:
+  std::string name_;
+  bool automatic_;
+  int64_t max_;
+  int64_t window_;
+  double tolerance_;
+  bool done_ = false;
+  bool steady_ = false;
+  int64_t previous_median_ = 0;
+  int64_t first_ns_ = 0;
+  int64_t last_ns_ = 0;
+  std::vector<int64_t> cold_;
+};
+
+}  // namespace benchcore
@@ -0,0 +1,201 @@
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "benchcore/capture.hpp"
+#include "benchcore/flags.hpp"
+
+// Offline analysis of a capture file written with --capture=FILE, see
+// benchcore/capture.hpp:
+//   captool FILE [--cdf-file=CSV] [--window-ms=N] [--series-file=CSV]
+//                [--outlier-pct=P]
+// Latencies are per hop, as the benchmarks report them: end to end divided
+// by the relays plus one.
+
+namespace {
+
+int64_t percentile(const std::vector<int64_t>& sorted, double p) {
+  if (sorted.empty()) {
+    return 0;
+  }
+  size_t index = static_cast<size_t>(p / 100 * (sorted.size() - 1) + 0.5);
+  return sorted[std::min(index, sorted.size() - 1)];
+}
+
+std::vector<int64_t> sorted_copy(std::vector<int64_t> values) {
+  std::sort(values.begin(), values.end());
+  return values;
+}
+
+// P50, P90, P99, P99.9 and max of the messages, in us.
+void print_summary(const std::vector<int64_t>& latency) {
+  std::vector<int64_t> sorted = sorted_copy(latency);
+  std::cout << "| P50 (us/hop) | P90 (us/hop) | P99 (us/hop) | P99.9 (us/hop) | Max (us/hop) |\n"
+            << "| ------------ | ------------ | ------------ | -------------- | ------------ |\n"
+            << "| " << percentile(sorted, 50) / 1000 << " | " << percentile(sorted, 90) / 1000
+            << " | " << percentile(sorted, 99) / 1000 << " | " << percentile(sorted, 99.9) / 1000
+            << " | " << sorted.back() / 1000 << " |\n";
+}
+
+// The CDF at fixed points, and every point to --cdf-file for plotting.
+void print_cdf(const benchcore::Flags& flags, const std::vector<int64_t>& latency) {
+  std::vector<int64_t> sorted = sorted_copy(latency);
+  std::cout << "\nCDF:\n| Fraction | Latency (us/hop) |\n| -------- | ---------------- |\n";
+  for (double p : {1.0, 10.0, 25.0, 50.0, 75.0, 90.0, 95.0, 99.0, 99.9, 99.99, 100.0}) {
+    std::cout << "| " << p << "% | " << percentile(sorted, p) / 1000.0 << " |\n";
+  }
+  if (flags.has("cdf-file")) {
+    std::ofstream out(flags.get("cdf-file"));
+    out << "latency_ns,fraction\n";
+    for (size_t i = 0; i < sorted.size(); ++i) {
+      if (i + 1 == sorted.size() || sorted[i + 1] != sorted[i]) {
+        out << sorted[i] << "," << static_cast<double>(i + 1) / sorted.size() << "\n";
+      }
+    }
+  }
+}
+
+// Messages, P50, P99 and max per --window-ms of arrival time, to show when
+// in the run the latency changed. Also to --series-file.
+void print_series(const benchcore::Flags& flags, const benchcore::CaptureReader& reader,
+                  const std::vector<int64_t>& latency) {
+  int64_t window_ns = flags.get_int("window-ms", 1000) * 1000000;
+  int64_t start = reader.record(0).arrived_ns;
+  for (uint64_t i = 0; i < reader.size(); ++i) {
+    start = std::min(start, reader.record(i).arrived_ns);
+  }
+  std::map<int64_t, std::vector<int64_t>> windows;
+  for (uint64_t i = 0; i < reader.size(); ++i) {
+    windows[(reader.record(i).arrived_ns - start) / window_ns].push_back(latency[i]);
+  }
+
+  std::ofstream series;
+  if (flags.has("series-file")) {
+    series.open(flags.get("series-file"));
+    series << "window_start_ms,messages,p50_ns,p99_ns,max_ns\n";
+  }
+  std::cout << "\nTime series, " << window_ns / 1000000 << "ms windows:\n"
+            << "| Start (ms) | Messages | P50 (us/hop) | P99 (us/hop) | Max (us/hop) |\n"
+            << "| ---------- | -------- | ------------ | ------------ | ------------ |\n";
+  for (auto& [window, values] : windows) {
+    std::sort(values.begin(), values.end());
+    int64_t start_ms = window * window_ns / 1000000;
+    std::cout << "| " << start_ms << " | " << values.size() << " | "
+              << percentile(values, 50) / 1000 << " | " << percentile(values, 99) / 1000 << " | "
+              << values.back() / 1000 << " |\n";
+    if (series.is_open()) {
+      series << start_ms << "," << values.size() << "," << percentile(values, 50) << ","
+             << percentile(values, 99) << "," << values.back() << "\n";
+    }
+  }
+}
+
+// Outliers, the messages over the --outlier-pct percentile, by the CPU and
+// the thread that received them. A group whose outlier rate is well above
+// the overall one points at e.g. a CPU shared with an interrupt or another
+// process.
+template <typename Key>
+void print_outliers_by(const std::string& name, const benchcore::CaptureReader& reader,
+                       const std::vector<bool>& outlier, double overall, Key key) {
+  std::map<int64_t, std::pair<int64_t, int64_t>> groups;
+  for (uint64_t i = 0; i < reader.size(); ++i) {
+    auto& [messages, outliers] = groups[key(reader.record(i))];
+    ++messages;
+    outliers += outlier[i];
+  }
+  std::cout << "| " << name << " | Messages | Outliers | Outlier rate vs. overall |\n"
+            << "| --- | -------- | -------- | ------------------------ |\n";
+  for (const auto& [group, counts] : groups) {
+    double rate = static_cast<double>(counts.second) / counts.first;
+    std::cout << "| " << group << " | " << counts.first << " | " << counts.second << " | "
+              << (overall > 0 ? rate / overall : 0) << "x |\n";
+  }
+}
+
+void print_outliers(const benchcore::Flags& flags, const benchcore::CaptureReader& reader,
+                    const std::vector<int64_t>& latency) {
+  double pct = flags.get_double("outlier-pct", 99);
+  int64_t threshold = percentile(sorted_copy(latency), pct);
+  std::vector<bool> outlier(latency.size());
+  int64_t outliers = 0;
+  for (size_t i = 0; i < latency.size(); ++i) {
+    outlier[i] = latency[i] > threshold;
+    outliers += outlier[i];
+  }
+  double overall = static_cast<double>(outliers) / latency.size();
+  std::cout << "\nOutliers over P" << pct << " (" << threshold / 1000 << "us/hop): " << outliers
+            << " messages\n";
+  print_outliers_by("CPU", reader, outlier, overall,
+                    [](const benchcore::CaptureRecord& record) { return record.cpu; });
+  std::cout << "\n";
+  print_outliers_by("Thread", reader, outlier, overall,
+                    [](const benchcore::CaptureRecord& record) { return record.tid; });
+
+  // With per-hop timestamps, which hops the outliers lost their time on.
+  uint32_t stamps = reader.header().stamps;
+  if (stamps < 2 || outliers == 0) {
+    return;
+  }
+  std::cout << "\nPer hop, P50 of all messages and of the outliers:\n"
+            << "| Hop | All (us) | Outliers (us) |\n| --- | -------- | ------------- |\n";
+  for (uint32_t hop = 1; hop < stamps; ++hop) {
+    std::vector<int64_t> all;
+    std::vector<int64_t> slow;
+    for (uint64_t i = 0; i < reader.size(); ++i) {
+      const int64_t* stamp = reader.stamps(i);
+      if (stamp[hop] == 0 || stamp[hop - 1] == 0) {
+        continue;
+      }
+      all.push_back(stamp[hop] - stamp[hop - 1]);
+      if (outlier[i]) {
+        slow.push_back(stamp[hop] - stamp[hop - 1]);
+      }
+    }
+    std::cout << "| " << hop << " | " << percentile(sorted_copy(all), 50) / 1000.0 << " | "
+              << percentile(sorted_copy(slow), 50) / 1000.0 << " |\n";
+  }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  benchcore::Flags flags(argc, argv);
+  if (flags.positional().size() != 1) {
+    std::cerr << "usage: captool FILE [--cdf-file=CSV] [--window-ms=N] [--series-file=CSV] "
+                 "[--outlier-pct=P]\n";
+    return 1;
+  }
+  if (flags.get_int("window-ms", 1000) <= 0) {
+    std::cerr << "--window-ms must be at least 1\n";
+    return 1;
+  }
+  benchcore::CaptureReader reader(flags.positional()[0]);
+  const benchcore::CaptureHeader& header = reader.header();
+  std::cout << reader.size() << " messages, " << header.num_relays << " relays";
+  if (reader.overwritten() > 0) {
+    std::cout << ", " << reader.overwritten() << " older ones overwritten";
+  }
+  if (header.stamps > 0) {
+    std::cout << ", " << header.stamps << " timestamps per message";
+  }
+  std::cout << "\n";
+  if (reader.size() == 0) {
+    return 0;
+  }
+
+  std::vector<int64_t> latency(reader.size());
+  for (uint64_t i = 0; i < reader.size(); ++i) {
+    const benchcore::CaptureRecord& record = reader.record(i);
+    latency[i] = (record.arrived_ns - record.sent_ns) / (header.num_relays + 1);
+  }
+  print_summary(latency);
+  print_cdf(flags, latency);
+  print_series(flags, reader, latency);
+  print_outliers(flags, reader, latency);
+  return 0;
+}
@@ -0,0 +1,348 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "benchcore/chain.hpp"
+#include "benchcore/clock.hpp"
+#include "benchcore/flags.hpp"
+#include "benchcore/traffic.hpp"
+
+// The chain without a framework: the same source, relays and sink as the
+// other benchmarks, with the hop count and the message type as template
+// parameters. What's left is the cost of passing a message on, the floor to
+// subtract from a framework's per-hop latency.
+
+// The message the frameworks carry.
+struct Timing {
+  int64_t msgid;
+  int64_t nanosec;
+  std::string source;
+};
+
+// The same message with a fixed size source, which copies without
+// allocating.
+struct FixedTiming {
+  int64_t msgid;
+  int64_t nanosec;
+  char source[16];
+};
+
+void set_source(Timing& msg, int hop) { msg.source = "relay " + std::to_string(hop); }
+void set_source(FixedTiming& msg, int hop) {
+  std::string source = "relay " + std::to_string(hop);
+  memcpy(msg.source, source.c_str(), source.size() + 1);
+}
+
+// What a relay does before passing a message on: a copy with its own source,
+// like the framework relays.
+struct CopyForward {
+  static constexpr const char* kName = "copy";
+
+  template <typename Message>
+  static Message forward(const Message& in, int hop) {
+    Message out = in;
+    set_source(out, hop);
+    return out;
+  }
+};
+
+// The same with a round trip through a byte buffer, as the frameworks
+// serialize between hops: the fields in order, the source length prefixed.
+struct SerializeForward {
+  static constexpr const char* kName = "serialize";
+
+  template <typename Message>
+  static Message forward(const Message& in, int hop) {
+    thread_local std::vector<uint8_t> buffer;
+    serialize(in, buffer);
+    Message out = deserialize<Message>(buffer);
+    set_source(out, hop);
+    return out;
+  }
+
+ private:
+  static void serialize(const Timing& msg, std::vector<uint8_t>& buffer) {
+    uint32_t size = msg.source.size();
+    buffer.resize(2 * sizeof(int64_t) + sizeof(size) + size);
+    uint8_t* p = buffer.data();
+    memcpy(p, &msg.msgid, sizeof(int64_t));
+    memcpy(p + 8, &msg.nanosec, sizeof(int64_t));
+    memcpy(p + 16, &size, sizeof(size));
+    memcpy(p + 20, msg.source.data(), size);
+  }
+  static void serialize(const FixedTiming& msg, std::vector<uint8_t>& buffer) {
+    buffer.resize(sizeof(msg));
+    memcpy(buffer.data(), &msg, sizeof(msg));
+  }
+  template <typename Message>
+  static Message deserialize(const std::vector<uint8_t>& buffer) {
+    Message msg;
+    if constexpr (std::is_same_v<Message, Timing>) {
+      uint32_t size;
+      memcpy(&msg.msgid, buffer.data(), sizeof(int64_t));
+      memcpy(&msg.nanosec, buffer.data() + 8, sizeof(int64_t));
+      memcpy(&size, buffer.data() + 16, sizeof(size));
+      msg.source.assign(reinterpret_cast<const char*>(buffer.data() + 20), size);
+    } else {
+      memcpy(&msg, buffer.data(), sizeof(msg));
+    }
+    return msg;
+  }
+};
+
+// Collects the per-hop latency of every message over `hops` hops.
+class Sink {
+ public:
+  Sink(int64_t messages, int hops) : hops_(hops) { samples_.reserve(messages); }
+
+  template <typename Message>
+  void receive(const Message& msg) {
+    samples_.push_back((benchcore::now_ns() - msg.nanosec) / hops_);
+    received_.store(samples_.size(), std::memory_order_release);
+  }
+  int64_t received() const { return received_.load(std::memory_order_acquire); }
+  std::vector<int64_t>& samples() { return samples_; }
+
+ private:
+  int hops_;
+  std::vector<int64_t> samples_;
+  std::atomic<int64_t> received_{0};
+};
+
+// Every hop is a function call on the source's thread. Each hop is its own
+// instantiation, kept out of line so it stays a call.
+template <int Hops, typename Message, typename Forward>
+class CallChain {
+ public:
+  static constexpr const char* kName = "call";
+  static constexpr int kHops = Hops;
+
+  explicit CallChain(Sink* sink) : sink_(sink) {}
+  void send(const Message& msg) { hop<0>(msg); }
+
+ private:
+  template <int kHop>
+  [[gnu::noinline]] void hop(const Message& msg) {
+    if constexpr (kHop == Hops - 1) {
+      sink_->receive(msg);
+    } else {
+      hop<kHop + 1>(Forward::forward(msg, kHop));
+    }
+  }
+
+  Sink* sink_;
+};
+
+// A one message slot between two threads, the receiver busy waiting for it
+// and yielding now and then so it also works with fewer cores than hops.
+template <typename Message>
+class SpinMailbox {
+ public:
+  static constexpr const char* kName = "spin";
+
+  void put(Message msg) {
+    while (full_.load(std::memory_order_acquire)) {
+    }
+    slot_ = std::move(msg);
+    full_.store(true, std::memory_order_release);
+  }
+  Message take() {
+    for (int spins = 0; !full_.load(std::memory_order_acquire); ++spins) {
+      if (spins % 1000 == 999) {
+        std::this_thread::yield();
+      }
+    }
+    Message msg = std::move(slot_);
+    full_.store(false, std::memory_order_release);
+    return msg;
+  }
+
+ private:
+  std::atomic<bool> full_{false};
+  Message slot_;
+};
+
+// A one message slot with a mutex and a condition variable, the receiver
+// sleeping until it's filled, like an executor thread waiting for work.
+template <typename Message>
+class WaitMailbox {
+ public:
+  static constexpr const char* kName = "wait";
+
+  void put(Message msg) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      changed_.wait(lock, [this]() { return !full_; });
+      slot_ = std::move(msg);
+      full_ = true;
+    }
+    changed_.notify_all();
+  }
+  Message take() {
+    Message msg;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      changed_.wait(lock, [this]() { return full_; });
+      msg = std::move(slot_);
+      full_ = false;
+    }
+    changed_.notify_all();
+    return msg;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  bool full_ = false;
+  Message slot_;
+};
+
+// A thread per relay and one for the sink, handing the message on through
+// a Mailbox per hop. A msgid of -1 stops the threads.
+template <int Hops, typename Message, typename Forward, template <typename> class Mailbox>
+class ThreadChain {
+ public:
+  static constexpr const char* kName = Mailbox<Message>::kName;
+  static constexpr int kHops = Hops;
+
+  explicit ThreadChain(Sink* sink) : sink_(sink) {
+    start(std::make_integer_sequence<int, Hops - 1>());
+    threads_.emplace_back([this]() {
+      for (Message msg = boxes_[Hops - 1].take(); msg.msgid >= 0;
+           msg = boxes_[Hops - 1].take()) {
+        sink_->receive(msg);
+      }
+    });
+  }
+  ~ThreadChain() {
+    Message stop{};
+    stop.msgid = -1;
+    boxes_[0].put(stop);
+    for (std::thread& thread : threads_) {
+      thread.join();
+    }
+  }
+
+  void send(const Message& msg) { boxes_[0].put(msg); }
+
+ private:
+  template <int... kHop>
+  void start(std::integer_sequence<int, kHop...>) {
+    (threads_.emplace_back([this]() { relay<kHop>(); }), ...);
+  }
+  template <int kHop>
+  void relay() {
+    while (true) {
+      Message msg = boxes_[kHop].take();
+      if (msg.msgid < 0) {
+        boxes_[kHop + 1].put(msg);
+        return;
+      }
+      boxes_[kHop + 1].put(Forward::forward(msg, kHop));
+    }
+  }
+
+  Sink* sink_;
+  std::array<Mailbox<Message>, Hops> boxes_;
+  std::vector<std::thread> threads_;
+};
+
+const char* message_name(const Timing&) { return "Timing"; }
+const char* message_name(const FixedTiming&) { return "FixedTiming"; }
+
+// Sends --messages messages through the chain at --rate-hz and prints a row
+// of the summary table.
+template <typename Chain, typename Message, typename Forward>
+void run_case(const benchcore::Flags& flags) {
+  int64_t messages = flags.get_int("messages", benchcore::kNumSamples);
+  Sink sink(messages, Chain::kHops);
+  {
+    Chain chain(&sink);
+    auto period = std::chrono::nanoseconds(
+        static_cast<int64_t>(1e9 / flags.get_double("rate-hz", 1000)));
+    benchcore::Pacer pacer(flags, period);
+    for (int64_t i = 0; i < messages; ++i) {
+      Message msg{};
+      msg.msgid = i;
+      set_source(msg, -1);
+      msg.nanosec = benchcore::now_ns();
+      chain.send(msg);
+      pacer.wait();
+    }
+    while (sink.received() < messages) {
+      std::this_thread::yield();
+    }
+  }
+  std::vector<int64_t>& samples = sink.samples();
+  std::sort(samples.begin(), samples.end());
+  std::cout << "| " << Chain::kHops - 1 << " | " << Chain::kName << " | "
+            << message_name(Message{}) << " | "
+            << Forward::kName << " | " << samples[samples.size() / 2] << " | "
+            << samples[samples.size() * 9 / 10] << " |" << std::endl;
+}
+
+template <int Hops, typename Message, typename Forward>
+void run_cases(const benchcore::Flags& flags, const std::vector<std::string>& chains) {
+  for (const std::string& chain : chains) {
+    if (chain == "call") {
+      run_case<CallChain<Hops, Message, Forward>, Message, Forward>(flags);
+    } else if (chain == "spin") {
+      run_case<ThreadChain<Hops, Message, Forward, SpinMailbox>, Message, Forward>(flags);
+    } else if (chain == "wait") {
+      run_case<ThreadChain<Hops, Message, Forward, WaitMailbox>, Message, Forward>(flags);
+    } else {
+      throw std::invalid_argument("unknown chain: " + chain);
+    }
+  }
+}
+
+// Every chain with both message types, copied and serialized per hop.
+template <int Hops>
+void run_length(const benchcore::Flags& flags, const std::vector<std::string>& chains) {
+  run_cases<Hops, Timing, CopyForward>(flags, chains);
+  run_cases<Hops, Timing, SerializeForward>(flags, chains);
+  run_cases<Hops, FixedTiming, CopyForward>(flags, chains);
+  run_cases<Hops, FixedTiming, SerializeForward>(flags, chains);
+}
+
+// --chains=call,spin,wait selects the chains, --relays=1,5,20 the chain
+// lengths, out of those instantiated, --rate-hz (default 1000) and --traffic
+// pace the source, --messages (default 1000) is the count per row.
+int main(int argc, char* argv[]) {
+  benchcore::Flags flags(argc, argv);
+  benchcore::init_clock(flags);
+  std::vector<std::string> chains = benchcore::split(flags.get("chains", "call,spin,wait"));
+  std::vector<std::string> lengths = benchcore::split(
+      flags.get("relays", "1,5," + std::to_string(benchcore::kNumRelays)));
+
+  std::cout << "Per-hop latency without a framework, in ns:\n"
+            << "| Relays | Chain | Message | Forward | P50 (ns/hop) | P90 (ns/hop) |\n"
+            << "| ------ | ----- | ------- | ------- | ------------ | ------------ |"
+            << std::endl;
+  for (const std::string& length : lengths) {
+    int relays = std::stoi(length);
+    if (relays == 1) {
+      run_length<2>(flags, chains);
+    } else if (relays == 5) {
+      run_length<6>(flags, chains);
+    } else if (relays == benchcore::kNumRelays) {
+      run_length<benchcore::kNumRelays + 1>(flags, chains);
+    } else {
+      throw std::invalid_argument("no chain of " + length + " relays, only 1, 5 and " +
+                                  std::to_string(benchcore::kNumRelays));
+    }
+  }
+  return 0;
+}
@@ -1,23 +1,47 @@
 #include <grpcpp/grpcpp.h>
 
+#include <chrono>
 #include <iostream>
+#include <map>
 #include <memory>
-#include <thread>
+#include <mutex>
+#include <string>
+#include <vector>
 
+#include "benchcore/bulk.hpp"
+#include "benchcore/chain.hpp"
+#include "benchcore/flags.hpp"
 #include "gbench/timing.grpc.pb.h"
+#include "gbench/tuning.hpp"
+
+// Connects to hop `hop` of the chain. Channels with the same arguments share
+// one connection, an isolated channel gets its own.
+std::shared_ptr<grpc::Channel> hop_channel(int hop, const GrpcOptions& options,
+                                           bool isolated = false) {
+  grpc::ChannelArguments args;
+  options.apply(args);
+  if (isolated) {
+    args.SetInt(GRPC_ARG_USE_LOCAL_SUBCHANNEL_POOL, 1);
+  }
+  return grpc::CreateCustomChannel("127.0.0.1:" + std::to_string(benchcore::kRelayPortStart + hop),
+                                   grpc::InsecureChannelCredentials(), args);
+}
 
-using namespace std::chrono_literals;
-constexpr int kRelayPortStart = 5000;
-constexpr int kNumRelays = 20;
+// Waits for a channel to connect, for up to retry_for. gRPC channels
+// otherwise connect on their first call.
+void wait_connected(grpc::Channel& channel, std::chrono::milliseconds retry_for) {
+  channel.WaitForConnected(std::chrono::system_clock::now() + retry_for);
+}
 
 // The base class for Relay and Sink services.
 class BenchServiceBase : public timing::Bench::Service {
  public:
-  BenchServiceBase(int id) : port_(id + kRelayPortStart) {}
+  BenchServiceBase(int id) : port_(id + benchcore::kRelayPortStart) {}
 
-  void run() {
+  void run(const GrpcOptions& options) {
     grpc::ServerBuilder builder;
     builder.AddListeningPort("0.0.0.0:" + std::to_string(port_), grpc::InsecureServerCredentials());
+    options.apply(builder);
     builder.RegisterService(this);
     server_ = builder.BuildAndStart();
     // std::cout << "Server Ready.\n";
@@ -30,13 +54,21 @@ class BenchServiceBase : public timing::Bench::Service {
 };
 
 // Relay service. After it gets a request, it immediately makes a request to
-// the next relay.
+// the next relay. Bulk messages go on the bulk channel, which is a connection
+// of its own with --bulk-isolation=isolated.
 class Relay final : public BenchServiceBase {
  public:
-  Relay(int id)
+  Relay(int id, const GrpcOptions& options, const benchcore::BulkConfig& bulk)
       : BenchServiceBase(id),
-        client_(timing::Bench::NewStub(grpc::CreateChannel("127.0.0.1:" + std::to_string(port_ + 1),
-                                                           grpc::InsecureChannelCredentials()))) {}
+        channel_(hop_channel(id + 1, options)),
+        client_(timing::Bench::NewStub(channel_)),
+        bulk_channel_(bulk.isolated ? hop_channel(id + 1, options, true) : channel_),
+        bulk_client_(timing::Bench::NewStub(bulk_channel_)) {}
+
+  void connect(std::chrono::milliseconds retry_for) {
+    wait_connected(*channel_, retry_for);
+    wait_connected(*bulk_channel_, retry_for);
+  }
 
   grpc::Status bench(grpc::ServerContext* context, const timing::Request* request,
                      timing::Response* response) override {
@@ -45,90 +77,165 @@ class Relay final : public BenchServiceBase {
     timing::Request copy;
     copy.set_msgid(request->msgid());
     copy.set_nanosec(request->nanosec());
-    copy.set_source("relay " + std::to_string(port_));
     timing::Response rsp;
+    if (benchcore::is_bulk(request->msgid())) {
+      copy.set_source(request->source());
+      bulk_client_->bench(&client_context, copy, &rsp);
+      return grpc::Status::OK;
+    }
+    copy.set_source("relay " + std::to_string(port_));
     // std::cout << "Sending request.\n";
     grpc::Status status = client_->bench(&client_context, copy, &rsp);
     return grpc::Status::OK;
   }
 
+  // Forwards a batch as it came. The calls are synchronous, so there's
+  // nothing else to coalesce it with.
+  grpc::Status bench_batch(grpc::ServerContext* context, const timing::BatchRequest* request,
+                           timing::Response* response) override {
+    response->set_ack(request->requests_size());
+    grpc::ClientContext client_context;
+    timing::BatchRequest copy = *request;
+    for (timing::Request& r : *copy.mutable_requests()) {
+      r.set_source("relay " + std::to_string(port_));
+    }
+    timing::Response rsp;
+    grpc::Status status = client_->bench_batch(&client_context, copy, &rsp);
+    return grpc::Status::OK;
+  }
+
  private:
+  std::shared_ptr<grpc::Channel> channel_;
   std::unique_ptr<timing::Bench::Stub> client_;
+  std::shared_ptr<grpc::Channel> bulk_channel_;
+  std::unique_ptr<timing::Bench::Stub> bulk_client_;
 };
 
-// Sink service. This is the last hop. After it gets a request, it calculates
-// the per-hop latency.
+// Sink service. This is the last hop. After it gets a request, it passes
+// the message to the recorder, which calculates the per-hop latency.
 class Sink final : public BenchServiceBase {
  public:
-  Sink(int id) : BenchServiceBase(id) {}
+  Sink(int id, benchcore::LatencyRecorder* recorder) : BenchServiceBase(id), recorder_(recorder) {}
   grpc::Status bench(grpc::ServerContext* context, const timing::Request* request,
                      timing::Response* response) override {
     response->set_ack(request->msgid());
-    int64_t nanosec = std::chrono::duration_cast<std::chrono::nanoseconds>(
-                          std::chrono::steady_clock::now().time_since_epoch())
-                          .count();
-    int64_t nanosec_per_hop = (nanosec - request->nanosec()) / (kNumRelays + 1);
-    data_.insert(nanosec_per_hop);
-    std::cout << "nano seconds per hop: " << nanosec_per_hop << "\n";
-
-    if (data_.size() >= 1000) {
-      print_stats();
-      exit(0);
+    if (benchcore::is_bulk(request->msgid())) {
+      recorder_->record_bulk(request->nanosec());
+      return grpc::Status::OK;
     }
-
+    int64_t nanosec = recorder_->arrived(1);
+    recorder_->record(request->msgid(), request->nanosec(), nanosec);
     return grpc::Status::OK;
   }
-
- private:
-  void print_stats() {
-    std::vector<int64_t> array(data_.cbegin(), data_.cend());
-    std::sort(array.begin(), array.end());
-    int p50_index = array.size() / 2;
-    int p90_index = array.size() * 9 / 10;
-    std::cout << "\nStats with " << array.size() << " data points, ns/hop:"
-              << "\nP50 = " << array[p50_index] / 1000 << "us, P90 = " << array[p90_index] / 1000
-              << "us\n\n";
+  grpc::Status bench_batch(grpc::ServerContext* context, const timing::BatchRequest* request,
+                           timing::Response* response) override {
+    response->set_ack(request->requests_size());
+    int64_t nanosec = recorder_->arrived(request->requests_size());
+    for (const timing::Request& r : request->requests()) {
+      recorder_->record(r.msgid(), r.nanosec(), nanosec);
+    }
+    return grpc::Status::OK;
   }
 
-  std::unordered_multiset<int64_t> data_;
+ private:
+  benchcore::LatencyRecorder* recorder_;
 };
 
-int main() {
-  grpc::EnableDefaultHealthCheckService(true);
-
-  // Create the relay and sink services.
-  std::vector<std::unique_ptr<Relay>> relays;
-  for (int i = 0; i < kNumRelays; ++i) {
-    relays.emplace_back(std::make_unique<Relay>(i));
-    relays[i]->run();
-  }
-  Sink sink(kNumRelays);
-  sink.run();
-  // Give them a second to initialize so not to interfere with benchmark run.
-  std::this_thread::sleep_for(1s);
-  std::cout << "Services initialized.\n";
-
-  // Create the client and send requests.
-  std::unique_ptr<timing::Bench::Stub> client = timing::Bench::NewStub(
-      grpc::CreateChannel("127.0.0.1:5000", grpc::InsecureChannelCredentials()));
-  for (int i = 0; i < 1000; ++i) {
+// The chain over gRPC, one server per hop.
+class GrpcTransport : public benchcore::ChainTransport {
+ public:
+  GrpcTransport(const GrpcOptions& options, const benchcore::BulkConfig& bulk)
+      : options_(options), bulk_(bulk) {}
+
+  void start_relay(int hop) override {
+    auto relay = std::make_unique<Relay>(hop, options_, bulk_);
+    relay->run(options_);
+    std::lock_guard<std::mutex> lock(mutex_);
+    relays_[hop] = std::move(relay);
+  }
+  void connect_relay(int hop, std::chrono::milliseconds retry_for) override {
+    Relay* relay;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      relay = relays_.at(hop).get();
+    }
+    relay->connect(retry_for);
+  }
+  void start_sink(int hop, benchcore::LatencyRecorder* recorder) override {
+    sink_ = std::make_unique<Sink>(hop, recorder);
+    sink_->run(options_);
+  }
+  void connect_source(std::chrono::milliseconds retry_for) override {
+    auto channel = hop_channel(0, options_);
+    if (retry_for.count() > 0) {
+      wait_connected(*channel, retry_for);
+    }
+    client_ = timing::Bench::NewStub(channel);
+  }
+  void connect_bulk_source(std::chrono::milliseconds retry_for) override {
+    auto channel = hop_channel(0, options_, bulk_.isolated);
+    if (retry_for.count() > 0) {
+      wait_connected(*channel, retry_for);
+    }
+    bulk_client_ = timing::Bench::NewStub(channel);
+  }
+  void send(std::vector<benchcore::ChainMessage> messages) override {
     grpc::ClientContext context;
-    timing::Request request;
-    request.set_msgid(10);
-    request.set_source("client");
-    request.set_nanosec(std::chrono::duration_cast<std::chrono::nanoseconds>(
-                            std::chrono::steady_clock::now().time_since_epoch())
-                            .count());
     timing::Response response;
-    grpc::Status status = client->bench(&context, request, &response);
+    grpc::Status status;
+    if (messages.size() == 1) {
+      status = client_->bench(&context, to_request(messages[0]), &response);
+    } else {
+      timing::BatchRequest request;
+      for (benchcore::ChainMessage& message : messages) {
+        *request.add_requests() = to_request(message);
+      }
+      status = client_->bench_batch(&context, request, &response);
+    }
     if (!status.ok()) {
       std::cout << "Status= " << status.error_message() << ", ack= " << response.ack() << "\n";
     }
-    std::this_thread::sleep_for(100ms);
   }
-  sink.wait();
-  for (int i = 0; i < kNumRelays; ++i) {
-    relays[i]->wait();
+  void send_bulk(benchcore::ChainMessage message) override {
+    grpc::ClientContext context;
+    timing::Response response;
+    bulk_client_->bench(&context, to_request(message), &response);
+  }
+  void wait() override {
+    if (sink_) {
+      sink_->wait();
+    }
+    for (auto& [hop, relay] : relays_) {
+      relay->wait();
+    }
+  }
+
+ private:
+  static timing::Request to_request(benchcore::ChainMessage& message) {
+    timing::Request request;
+    request.set_msgid(message.msgid);
+    request.set_nanosec(message.nanosec);
+    request.set_source(std::move(message.source));
+    return request;
   }
-  return 0;
-}
\ No newline at end of file
+
+  GrpcOptions options_;
+  benchcore::BulkConfig bulk_;
+  std::mutex mutex_;
+  std::map<int, std::unique_ptr<Relay>> relays_;
+  std::unique_ptr<Sink> sink_;
+  std::unique_ptr<timing::Bench::Stub> client_;
+  std::unique_ptr<timing::Bench::Stub> bulk_client_;
+};
+
+// See benchcore::run_chain() for the flags, and tuning.hpp for gRPC's own.
+int main(int argc, char* argv[]) {
+  benchcore::Flags flags(argc, argv);
+  // With --grpc-sweep, run this binary once per channel and server setting.
+  if (flags.has("grpc-sweep")) {
+    return run_grpc_sweep(flags);
+  }
+  grpc::EnableDefaultHealthCheckService(true);
+  GrpcTransport transport(GrpcOptions::from_flags(flags), benchcore::BulkConfig::from_flags(flags));
+  return benchcore::run_chain(flags, transport);
+}
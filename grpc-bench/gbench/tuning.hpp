@@ -0,0 +1,192 @@
+#pragma once
+
+#include <grpcpp/grpcpp.h>
+#include <grpcpp/resource_quota.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <regex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "benchcore/bulk.hpp"
+#include "benchcore/flags.hpp"
+#include "benchcore/sweep.hpp"
+
+// Channel and server settings, all gRPC's defaults unless given:
+//   --grpc-min-pollers=N, --grpc-max-pollers=N
+//                              sync server threads polling for requests
+//   --grpc-max-threads=N       sync server threads in all, via a ResourceQuota
+//   --grpc-cqs=N               sync server completion queues
+//   --grpc-window-kb=N         HTTP/2 flow-control window, with BDP probing off
+//   --grpc-max-message-mb=N    max message size, both ways. Without it, gRPC's
+//                              4MB receive limit, raised to fit --bulk-size
+//   --grpc-keepalive-ms=N      keepalive ping interval, also without calls
+//   --grpc-compression=none|deflate|gzip
+//   --grpc-local-pool          a subchannel pool per channel rather than the
+//                              global one, so no two channels share a connection
+struct GrpcOptions {
+  int min_pollers = 0;
+  int max_pollers = 0;
+  int max_threads = 0;
+  int cqs = 0;
+  int window_kb = 0;
+  // 0 for gRPC's own limits.
+  int max_message_bytes = 0;
+  int keepalive_ms = 0;
+  grpc_compression_algorithm compression = GRPC_COMPRESS_NONE;
+  bool local_pool = false;
+
+  static GrpcOptions from_flags(const benchcore::Flags& flags) {
+    GrpcOptions options;
+    options.min_pollers = flags.get_int("grpc-min-pollers", 0);
+    options.max_pollers = flags.get_int("grpc-max-pollers", 0);
+    options.max_threads = flags.get_int("grpc-max-threads", 0);
+    options.cqs = flags.get_int("grpc-cqs", 0);
+    options.window_kb = flags.get_int("grpc-window-kb", 0);
+    options.max_message_bytes = max_message_bytes_for(flags);
+    options.keepalive_ms = flags.get_int("grpc-keepalive-ms", 0);
+    std::string compression = flags.get("grpc-compression", "none");
+    if (compression == "deflate") {
+      options.compression = GRPC_COMPRESS_DEFLATE;
+    } else if (compression == "gzip") {
+      options.compression = GRPC_COMPRESS_GZIP;
+    } else if (compression != "none") {
+      throw std::invalid_argument("unknown compression: " + compression);
+    }
+    options.local_pool = flags.get_bool("grpc-local-pool");
+    return options;
+  }
+
+  void apply(grpc::ChannelArguments& args) const {
+    if (window_kb > 0) {
+      args.SetInt(GRPC_ARG_HTTP2_BDP_PROBE, 0);
+      args.SetInt(GRPC_ARG_HTTP2_STREAM_LOOKAHEAD_BYTES, window_kb * 1024);
+    }
+    if (max_message_bytes > 0) {
+      args.SetMaxReceiveMessageSize(max_message_bytes);
+      args.SetMaxSendMessageSize(max_message_bytes);
+    }
+    if (keepalive_ms > 0) {
+      args.SetInt(GRPC_ARG_KEEPALIVE_TIME_MS, keepalive_ms);
+      args.SetInt(GRPC_ARG_KEEPALIVE_PERMIT_WITHOUT_CALLS, 1);
+      args.SetInt(GRPC_ARG_HTTP2_MAX_PINGS_WITHOUT_DATA, 0);
+    }
+    if (compression != GRPC_COMPRESS_NONE) {
+      args.SetCompressionAlgorithm(compression);
+    }
+    if (local_pool) {
+      args.SetInt(GRPC_ARG_USE_LOCAL_SUBCHANNEL_POOL, 1);
+    }
+  }
+
+  void apply(grpc::ServerBuilder& builder) const {
+    using SyncServerOption = grpc::ServerBuilder::SyncServerOption;
+    if (min_pollers > 0) {
+      builder.SetSyncServerOption(SyncServerOption::MIN_POLLERS, min_pollers);
+    }
+    if (max_pollers > 0) {
+      builder.SetSyncServerOption(SyncServerOption::MAX_POLLERS, max_pollers);
+    }
+    if (cqs > 0) {
+      builder.SetSyncServerOption(SyncServerOption::NUM_CQS, cqs);
+    }
+    if (max_threads > 0) {
+      grpc::ResourceQuota quota("gbench");
+      quota.SetMaxThreads(max_threads);
+      builder.SetResourceQuota(quota);
+    }
+    if (window_kb > 0) {
+      builder.AddChannelArgument(GRPC_ARG_HTTP2_BDP_PROBE, 0);
+      builder.AddChannelArgument(GRPC_ARG_HTTP2_STREAM_LOOKAHEAD_BYTES, window_kb * 1024);
+    }
+    if (max_message_bytes > 0) {
+      builder.SetMaxReceiveMessageSize(max_message_bytes);
+      builder.SetMaxSendMessageSize(max_message_bytes);
+    }
+    if (keepalive_ms > 0) {
+      builder.AddChannelArgument(GRPC_ARG_KEEPALIVE_TIME_MS, keepalive_ms);
+      builder.AddChannelArgument(GRPC_ARG_KEEPALIVE_PERMIT_WITHOUT_CALLS, 1);
+      builder.AddChannelArgument(GRPC_ARG_HTTP2_MIN_RECV_PING_INTERVAL_WITHOUT_DATA_MS,
+                                 keepalive_ms);
+    }
+    if (compression != GRPC_COMPRESS_NONE) {
+      builder.SetDefaultCompressionAlgorithm(compression);
+    }
+  }
+
+ private:
+  // Room for a message's fields besides the bulk payload.
+  static constexpr int64_t kMessageOverhead = 1024;
+
+  // --grpc-max-message-mb, or with bulk messages over gRPC's receive limit,
+  // enough for them. Clamped to what the int limits hold.
+  static int max_message_bytes_for(const benchcore::Flags& flags) {
+    int64_t bytes = flags.get_int("grpc-max-message-mb", 0) << 20;
+    if (bytes <= 0) {
+      int64_t bulk = benchcore::BulkConfig::from_flags(flags).size + kMessageOverhead;
+      bytes = bulk > GRPC_DEFAULT_MAX_RECV_MESSAGE_LENGTH ? bulk : 0;
+    }
+    return static_cast<int>(std::min<int64_t>(bytes, std::numeric_limits<int>::max()));
+  }
+};
+
+// The settings of --grpc-sweep: each option alone, and the ones that may
+// help latency together.
+inline const std::vector<std::pair<std::string, std::vector<std::string>>> kGrpcSweep = {
+    {"defaults", {}},
+    {"pollers", {"--grpc-min-pollers=1", "--grpc-max-pollers=2"}},
+    {"threads", {"--grpc-max-threads=4"}},
+    {"cqs", {"--grpc-cqs=1"}},
+    {"window", {"--grpc-window-kb=1024"}},
+    {"max-message", {"--grpc-max-message-mb=4"}},
+    {"keepalive", {"--grpc-keepalive-ms=1000"}},
+    {"gzip", {"--grpc-compression=gzip"}},
+    {"local-pool", {"--grpc-local-pool"}},
+    {"tuned",
+     {"--grpc-min-pollers=1", "--grpc-max-pollers=2", "--grpc-cqs=1", "--grpc-window-kb=1024",
+      "--grpc-local-pool"}},
+};
+
+// With --grpc-sweep, runs this binary once per setting, twice each: at the
+// usual rate for latency, and as fast as the calls return for throughput.
+// --grpc-sweep=defaults,window,... runs a subset of kGrpcSweep. Other flags
+// are passed on to every run.
+inline int run_grpc_sweep(const benchcore::Flags& flags) {
+  std::vector<std::string> names;
+  if (flags.get("grpc-sweep") != "true") {
+    names = benchcore::split(flags.get("grpc-sweep"));
+  }
+  // Every setting runs twice, at the usual rate and as fast as it goes. A
+  // --batch-size of 1 sends single messages but reports throughput.
+  std::vector<std::string> settings;
+  std::vector<benchcore::SweepCase> cases;
+  for (const auto& [name, args] : kGrpcSweep) {
+    if (!names.empty() && std::find(names.begin(), names.end(), name) == names.end()) {
+      continue;
+    }
+    settings.push_back(name);
+    cases.push_back({name, args});
+    cases.push_back({name + " at full rate", args});
+    cases.back().args.insert(cases.back().args.end(), {"--rate-hz=1000000", "--batch-size=1"});
+  }
+  std::vector<benchcore::SweepRun> runs =
+      benchcore::run_sweep(flags, {"--grpc-"}, cases, std::chrono::seconds(300));
+
+  static const std::regex throughput_re("Throughput: (\\d+) msg/s");
+  std::vector<std::vector<std::string>> rows;
+  for (size_t i = 0; i < settings.size(); ++i) {
+    const benchcore::SweepRun& run = runs[2 * i];
+    rows.push_back({settings[i], run.stats.p50_cell(), run.stats.p90_cell(),
+                    benchcore::find_in_output(runs[2 * i + 1].process, throughput_re)});
+  }
+  benchcore::print_sweep_table(
+      std::cout, "gRPC tuning sweep:",
+      {"Setting", "P50 (us/hop)", "P90 (us/hop)", "Throughput (msg/s)"}, rows);
+  return 0;
+}
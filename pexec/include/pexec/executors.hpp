@@ -0,0 +1,32 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "benchcore/flags.hpp"
+#include "rclcpp/executor.hpp"
+
+namespace pexec {
+
+// Creates the executor selected with --executor, so the benchmarks can be
+// compared across executors without code changes:
+//   multi       rclcpp::executors::MultiThreadedExecutor (default)
+//   single      rclcpp::executors::SingleThreadedExecutor
+//   events      rclcpp::experimental::executors::EventsExecutor
+//   lowlatency  pexec::LowLatencyExecutor
+// --exec-threads sets the thread count of multi and lowlatency. lowlatency
+// is further tuned with --exec-busy-poll, --exec-steal=false,
+// --exec-spin=<spins before parking> and --exec-cpus=<cpu,cpu,...>.
+std::unique_ptr<rclcpp::Executor> make_executor(const benchcore::Flags& flags);
+
+// The name of the executor make_executor() creates.
+std::string executor_name(const benchcore::Flags& flags);
+
+// With --executor-sweep, runs this binary once per executor: multi, single,
+// events, lowlatency, and lowlatency with --exec-busy-poll, and prints P50
+// and P90 per hop of each as a table. --executor-sweep=single,lowlatency,...
+// runs a subset, where lowlatency-busy-poll is the last one. Other flags,
+// e.g. --exec-threads, are passed on to every run.
+int run_executor_sweep(const benchcore::Flags& flags);
+
+}  // namespace pexec
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "pexec/ready_queue.hpp"
+#include "rclcpp/executor.hpp"
+#include "rclcpp/node_interfaces/node_base_interface.hpp"
+
+namespace pexec {
+
+struct LowLatencyExecutorOptions {
+  // Number of worker threads, including the one calling spin(). 0 uses one
+  // per hardware thread, like MultiThreadedExecutor.
+  size_t number_of_threads = 0;
+  // Poll the wait set with a zero timeout instead of blocking in it. Trades
+  // a busy core for not having to be woken up by the middleware.
+  bool busy_poll = false;
+  // Let idle workers take executables queued for other workers.
+  bool work_stealing = true;
+  // Number of empty polls of the queues an idle worker spins for before it
+  // parks itself.
+  int spin_before_park = 2000;
+  // Pin worker i to cpus[i % cpus.size()]. Empty leaves them unpinned.
+  std::vector<int> cpus;
+  // Capacity of each worker's ready queue.
+  size_t queue_capacity = 1024;
+};
+
+// An executor that hands ready executables to worker threads through
+// lock-free per-worker queues.
+//
+// Idle workers take turns polling the wait set: the one holding the poll
+// lock waits for work, then drains every ready executable into the queue of
+// the worker the executable's node is assigned to, and wakes that worker.
+// Nodes are assigned to workers round-robin as they are first seen, or
+// explicitly with set_node_affinity(). Workers run their own queue first,
+// then steal from the other queues, then try to become the poller, and park
+// only after spinning for a while without finding work.
+//
+// Callback group semantics are the same as in MultiThreadedExecutor, since
+// executables are still taken through Executor::get_next_ready_executable().
+class LowLatencyExecutor : public rclcpp::Executor {
+ public:
+  explicit LowLatencyExecutor(
+      const LowLatencyExecutorOptions& options = LowLatencyExecutorOptions(),
+      const rclcpp::ExecutorOptions& executor_options = rclcpp::ExecutorOptions());
+  ~LowLatencyExecutor() override;
+
+  void spin() override;
+
+  // Runs the executables of node on the given worker, unless they are stolen.
+  void set_node_affinity(const rclcpp::node_interfaces::NodeBaseInterface::SharedPtr& node,
+                         size_t worker);
+
+  size_t number_of_threads() const { return queues_.size(); }
+
+ private:
+  enum class PollResult {
+    kBusy,        // Another worker is polling.
+    kIdle,        // Polled the wait set, nothing was ready.
+    kDispatched,  // Queued ready executables.
+  };
+
+  void run(size_t worker);
+  PollResult poll(size_t worker);
+  bool steal(size_t worker, rclcpp::AnyExecutable& exec);
+  void execute(rclcpp::AnyExecutable& exec);
+  size_t worker_for(const rclcpp::AnyExecutable& exec, size_t poller);
+  bool running();
+
+  static constexpr std::chrono::milliseconds kParkTimeout{10};
+
+  LowLatencyExecutorOptions options_;
+  std::vector<std::unique_ptr<ReadyQueue>> queues_;
+  std::vector<std::unique_ptr<Parker>> parkers_;
+  // Held by the worker that is currently polling the wait set.
+  std::mutex poll_mutex_;
+  // Node to worker assignment, guarded by poll_mutex_.
+  std::unordered_map<const void*, size_t> affinity_;
+  size_t next_worker_ = 0;
+};
+
+}  // namespace pexec
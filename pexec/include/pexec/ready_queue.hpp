@@ -0,0 +1,135 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+#include "rclcpp/any_executable.hpp"
+
+namespace pexec {
+
+// Moves a ready executable from one slot to another. AnyExecutable has no
+// move operations, and its destructor releases the callback group, so copy
+// it and clear the source: only one copy may own the callback group.
+inline void transfer(rclcpp::AnyExecutable& from, rclcpp::AnyExecutable& to) {
+  to = from;
+  from = rclcpp::AnyExecutable();
+}
+
+// A bounded lock-free multi-producer multi-consumer queue of ready
+// executables, after Dmitry Vyukov's array based MPMC queue. Each cell has a
+// sequence number that tells whether it is free to write or ready to read at
+// a given position, so push and pop only contend on one atomic each.
+class ReadyQueue {
+ public:
+  explicit ReadyQueue(size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) {
+      size *= 2;
+    }
+    mask_ = size - 1;
+    cells_ = std::make_unique<Cell[]>(size);
+    for (size_t i = 0; i < size; ++i) {
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  // Returns false if the queue is full. On success exec is left empty.
+  bool push(rclcpp::AnyExecutable& exec) {
+    size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+      cell = &cells_[pos & mask_];
+      size_t seq = cell->sequence.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = enqueue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+    transfer(exec, cell->exec);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Returns false if the queue is empty.
+  bool pop(rclcpp::AnyExecutable& exec) {
+    size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+      cell = &cells_[pos & mask_];
+      size_t seq = cell->sequence.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+      if (diff == 0) {
+        if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = dequeue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+    transfer(cell->exec, exec);
+    cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+    return true;
+  }
+
+ private:
+  struct alignas(64) Cell {
+    std::atomic<size_t> sequence;
+    rclcpp::AnyExecutable exec;
+  };
+
+  std::unique_ptr<Cell[]> cells_;
+  size_t mask_;
+  alignas(64) std::atomic<size_t> enqueue_pos_{0};
+  alignas(64) std::atomic<size_t> dequeue_pos_{0};
+};
+
+// Parks an idle worker thread until it is handed work. An unpark() that
+// comes before the park is not lost, and unpark() only takes the mutex when
+// the worker is actually asleep.
+class Parker {
+ public:
+  void park_for(std::chrono::nanoseconds timeout) {
+    if (state_.exchange(kEmpty, std::memory_order_acquire) == kNotified) {
+      return;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    int expected = kEmpty;
+    if (state_.compare_exchange_strong(expected, kParked, std::memory_order_acq_rel)) {
+      cv_.wait_for(lock, timeout,
+                   [this]() { return state_.load(std::memory_order_acquire) == kNotified; });
+    }
+    state_.store(kEmpty, std::memory_order_release);
+  }
+
+  void unpark() {
+    if (state_.exchange(kNotified, std::memory_order_acq_rel) == kParked) {
+      // Taking the mutex makes sure the worker is inside wait_for().
+      std::lock_guard<std::mutex> lock(mutex_);
+      cv_.notify_one();
+    }
+  }
+
+ private:
+  static constexpr int kEmpty = 0;
+  static constexpr int kParked = 1;
+  static constexpr int kNotified = 2;
+
+  std::atomic<int> state_{kEmpty};
+  std::mutex mutex_;
+  std::condition_variable cv_;
+};
+
+}  // namespace pexec
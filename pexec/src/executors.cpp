@@ -0,0 +1,84 @@
+#include "pexec/executors.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "benchcore/sweep.hpp"
+#include "pexec/low_latency_executor.hpp"
+#include "rclcpp/experimental/executors/events_executor/events_executor.hpp"
+#include "rclcpp/rclcpp.hpp"
+
+namespace pexec {
+
+std::string executor_name(const benchcore::Flags& flags) { return flags.get("executor", "multi"); }
+
+std::unique_ptr<rclcpp::Executor> make_executor(const benchcore::Flags& flags) {
+  std::string name = executor_name(flags);
+  size_t threads = flags.get_int("exec-threads", 0);
+  if (name == "multi") {
+    return std::make_unique<rclcpp::executors::MultiThreadedExecutor>(rclcpp::ExecutorOptions(),
+                                                                      threads);
+  }
+  if (name == "single") {
+    return std::make_unique<rclcpp::executors::SingleThreadedExecutor>();
+  }
+  if (name == "events") {
+    return std::make_unique<rclcpp::experimental::executors::EventsExecutor>();
+  }
+  if (name == "lowlatency") {
+    LowLatencyExecutorOptions options;
+    options.number_of_threads = threads;
+    options.busy_poll = flags.get_bool("exec-busy-poll");
+    options.work_stealing = flags.get_bool("exec-steal", true);
+    options.spin_before_park = flags.get_int("exec-spin", options.spin_before_park);
+    for (const std::string& cpu : benchcore::split(flags.get("exec-cpus"))) {
+      options.cpus.push_back(std::stoi(cpu));
+    }
+    return std::make_unique<LowLatencyExecutor>(options);
+  }
+  throw std::invalid_argument("unknown executor: " + name);
+}
+
+int run_executor_sweep(const benchcore::Flags& flags) {
+  static const std::vector<std::pair<std::string, std::vector<std::string>>> kExecutors = {
+      {"multi", {"--executor=multi"}},
+      {"single", {"--executor=single"}},
+      {"events", {"--executor=events"}},
+      {"lowlatency", {"--executor=lowlatency"}},
+      {"lowlatency-busy-poll", {"--executor=lowlatency", "--exec-busy-poll"}},
+  };
+  std::vector<std::string> names;
+  if (flags.get("executor-sweep") != "true") {
+    names = benchcore::split(flags.get("executor-sweep"));
+  }
+  for (const std::string& name : names) {
+    if (std::none_of(kExecutors.begin(), kExecutors.end(),
+                     [&](const auto& executor) { return executor.first == name; })) {
+      throw std::invalid_argument("unknown executor: " + name);
+    }
+  }
+  std::vector<benchcore::SweepCase> cases;
+  for (const auto& [name, args] : kExecutors) {
+    if (names.empty() || std::find(names.begin(), names.end(), name) != names.end()) {
+      cases.push_back({name, args});
+    }
+  }
+  // Strips --executor-sweep too.
+  std::vector<benchcore::SweepRun> runs =
+      benchcore::run_sweep(flags, {"--executor", "--exec-busy-poll"}, cases,
+                           std::chrono::seconds(300));
+
+  std::vector<std::vector<std::string>> rows;
+  for (size_t i = 0; i < runs.size(); ++i) {
+    rows.push_back({cases[i].name, runs[i].stats.p50_cell(), runs[i].stats.p90_cell()});
+  }
+  benchcore::print_sweep_table(std::cout, "Executor sweep:",
+                               {"Executor", "P50 (us/hop)", "P90 (us/hop)"}, rows);
+  return 0;
+}
+
+}  // namespace pexec
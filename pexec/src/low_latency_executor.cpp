@@ -0,0 +1,176 @@
+#include "pexec/low_latency_executor.hpp"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
+#include "rclcpp/rclcpp.hpp"
+#include "rcpputils/scope_exit.hpp"
+
+namespace pexec {
+
+namespace {
+
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield");
+#endif
+}
+
+void pin_current_thread(int cpu) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+}  // namespace
+
+LowLatencyExecutor::LowLatencyExecutor(const LowLatencyExecutorOptions& options,
+                                       const rclcpp::ExecutorOptions& executor_options)
+    : rclcpp::Executor(executor_options), options_(options) {
+  size_t threads = options_.number_of_threads;
+  if (threads == 0) {
+    threads = std::max(std::thread::hardware_concurrency(), 2U);
+  }
+  for (size_t i = 0; i < threads; ++i) {
+    queues_.push_back(std::make_unique<ReadyQueue>(options_.queue_capacity));
+    parkers_.push_back(std::make_unique<Parker>());
+  }
+}
+
+LowLatencyExecutor::~LowLatencyExecutor() {}
+
+void LowLatencyExecutor::spin() {
+  if (spinning.exchange(true)) {
+    throw std::runtime_error("spin() called while already spinning");
+  }
+  RCPPUTILS_SCOPE_EXIT(this->spinning.store(false););
+  std::vector<std::thread> threads;
+  for (size_t worker = 1; worker < queues_.size(); ++worker) {
+    threads.emplace_back([this, worker]() { run(worker); });
+  }
+  run(0);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+void LowLatencyExecutor::set_node_affinity(
+    const rclcpp::node_interfaces::NodeBaseInterface::SharedPtr& node, size_t worker) {
+  std::lock_guard<std::mutex> lock(poll_mutex_);
+  affinity_[node.get()] = worker % queues_.size();
+}
+
+bool LowLatencyExecutor::running() { return rclcpp::ok(this->context_) && spinning.load(); }
+
+void LowLatencyExecutor::run(size_t worker) {
+  if (!options_.cpus.empty()) {
+    pin_current_thread(options_.cpus[worker % options_.cpus.size()]);
+  }
+  int idle_spins = 0;
+  while (running()) {
+    rclcpp::AnyExecutable exec;
+    if (queues_[worker]->pop(exec) || (options_.work_stealing && steal(worker, exec))) {
+      execute(exec);
+      idle_spins = 0;
+      continue;
+    }
+    PollResult result = poll(worker);
+    if (result == PollResult::kDispatched || (result == PollResult::kIdle && options_.busy_poll)) {
+      idle_spins = 0;
+      continue;
+    }
+    if (++idle_spins < options_.spin_before_park) {
+      cpu_relax();
+      continue;
+    }
+    idle_spins = 0;
+    parkers_[worker]->park_for(kParkTimeout);
+  }
+  // Wake everyone up so they notice the executor stopped.
+  for (auto& parker : parkers_) {
+    parker->unpark();
+  }
+}
+
+bool LowLatencyExecutor::steal(size_t worker, rclcpp::AnyExecutable& exec) {
+  for (size_t i = 1; i < queues_.size(); ++i) {
+    if (queues_[(worker + i) % queues_.size()]->pop(exec)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+LowLatencyExecutor::PollResult LowLatencyExecutor::poll(size_t worker) {
+  std::unique_lock<std::mutex> lock(poll_mutex_, std::try_to_lock);
+  if (!lock.owns_lock() || !running()) {
+    return PollResult::kBusy;
+  }
+
+  rclcpp::AnyExecutable exec;
+  if (!get_next_ready_executable(exec)) {
+    wait_for_work(options_.busy_poll ? std::chrono::nanoseconds(0)
+                                     : std::chrono::nanoseconds(-1));
+    if (!get_next_ready_executable(exec)) {
+      return PollResult::kIdle;
+    }
+  }
+
+  // Drain everything that is ready, so the other workers can start on it
+  // while this one goes back to its own queue.
+  do {
+    size_t target = worker_for(exec, worker);
+    if (!queues_[target]->push(exec)) {
+      // The target's queue is full. Run it here rather than drop it.
+      lock.unlock();
+      execute(exec);
+      return PollResult::kDispatched;
+    }
+    if (target != worker) {
+      parkers_[target]->unpark();
+    }
+  } while (get_next_ready_executable(exec));
+  lock.unlock();
+
+  // This worker is about to run callbacks, so hand the polling over to the
+  // next worker in case it is parked.
+  parkers_[(worker + 1) % parkers_.size()]->unpark();
+  return PollResult::kDispatched;
+}
+
+size_t LowLatencyExecutor::worker_for(const rclcpp::AnyExecutable& exec, size_t poller) {
+  if (!exec.node_base) {
+    return poller;
+  }
+  auto it = affinity_.find(exec.node_base.get());
+  if (it != affinity_.end()) {
+    return it->second;
+  }
+  size_t worker = next_worker_++ % queues_.size();
+  affinity_.emplace(exec.node_base.get(), worker);
+  return worker;
+}
+
+void LowLatencyExecutor::execute(rclcpp::AnyExecutable& exec) {
+  execute_any_executable(exec);
+
+  // Same as MultiThreadedExecutor: wake the poller, so it picks up work of
+  // the mutually exclusive group that just became available again.
+  if (exec.callback_group &&
+      exec.callback_group->type() == rclcpp::CallbackGroupType::MutuallyExclusive &&
+      !options_.busy_poll) {
+    interrupt_guard_condition_->trigger();
+  }
+  // Clear the callback_group to prevent the AnyExecutable destructor from
+  // resetting the callback group `can_be_taken_from`.
+  exec.callback_group.reset();
+}
+
+}  // namespace pexec
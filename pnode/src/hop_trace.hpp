@@ -0,0 +1,154 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#include "rclcpp/message_info.hpp"
+
+// Timestamps of one message on one hop. All of them are system clock
+// nanoseconds, since that is the clock DDS uses for the message info
+// source and received timestamps.
+struct HopStamps {
+  std::atomic<int64_t> sent{0};       // DDS source timestamp, stamped by the sender's publish.
+  std::atomic<int64_t> received{0};   // DDS data-available on this hop's reader.
+  std::atomic<int64_t> picked{0};     // An executor thread took the subscription out of the wait set.
+  std::atomic<int64_t> callback{0};   // The subscription callback started.
+  std::atomic<int64_t> published{0};  // The relay's own publish returned. Unset on the sink.
+};
+
+inline int64_t trace_now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+// Per-hop timestamps for the messages going through the chain. Hop i is the
+// reception by relay i, and the last hop is the reception by the sink. Each
+// hop writes its own slot, and the sink reads them all once the run is done,
+// so tracing costs a handful of relaxed stores per hop.
+template <int kNumHops>
+class HopTrace {
+ public:
+  static constexpr size_t kCapacity = 4096;
+  // The timestamps stamps() returns.
+  static constexpr int kStamps = kNumHops + 1;
+
+  HopTrace() : stamps_(kCapacity) {}
+
+  // Records the reception of msgid on hop, from within the subscription
+  // callback. picked is the time the executor thread took the subscription.
+  void on_callback(int64_t msgid, int hop, const rclcpp::MessageInfo& info, int64_t picked) {
+    HopStamps& s = slot(msgid, hop);
+    s.callback.store(trace_now(), std::memory_order_relaxed);
+    s.sent.store(info.get_rmw_message_info().source_timestamp, std::memory_order_relaxed);
+    s.received.store(info.get_rmw_message_info().received_timestamp, std::memory_order_relaxed);
+    s.picked.store(picked, std::memory_order_relaxed);
+  }
+
+  void on_published(int64_t msgid, int hop) {
+    slot(msgid, hop).published.store(trace_now(), std::memory_order_relaxed);
+  }
+
+  // The source's publish of msgid, then the start of the callback on every
+  // hop, kNumHops + 1 timestamps in all. 0 where unknown.
+  void stamps(int64_t msgid, int64_t* out) const {
+    out[0] = slot(msgid, 0).sent.load(std::memory_order_relaxed);
+    for (int hop = 0; hop < kNumHops; ++hop) {
+      out[hop + 1] = slot(msgid, hop).callback.load(std::memory_order_relaxed);
+    }
+  }
+
+  // Marks msgid as complete, i.e. it reached the sink.
+  void on_complete(int64_t msgid) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    completed_.push_back(msgid);
+  }
+
+  // Prints the breakdown of each hop into middleware (publish to DDS data
+  // available), queueing (data available to an executor thread taking it),
+  // dispatch (take and deserialize until the callback starts) and callback
+  // (callback start until its publish returns) time.
+  void print(std::ostream& out) const {
+    std::vector<int64_t> msgids;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      msgids = completed_;
+    }
+    if (msgids.size() > kCapacity) {
+      msgids.erase(msgids.begin(), msgids.end() - kCapacity);
+    }
+
+    std::array<std::vector<int64_t>, kNumComponents> all;
+    std::vector<std::array<std::vector<int64_t>, kNumComponents>> per_hop(kNumHops);
+    for (int64_t msgid : msgids) {
+      for (int hop = 0; hop < kNumHops; ++hop) {
+        const HopStamps& s = slot(msgid, hop);
+        int64_t sent = s.sent.load(std::memory_order_relaxed);
+        int64_t received = s.received.load(std::memory_order_relaxed);
+        int64_t picked = s.picked.load(std::memory_order_relaxed);
+        int64_t callback = s.callback.load(std::memory_order_relaxed);
+        int64_t published = s.published.load(std::memory_order_relaxed);
+        std::array<int64_t, kNumComponents> values = {
+            received - sent, picked - received, callback - picked, published - callback};
+        for (int c = 0; c < kNumComponents; ++c) {
+          // The sink doesn't publish, and rmw implementations that don't
+          // fill in the message info timestamps leave them at 0.
+          if ((c == 3 && published == 0) || (c <= 1 && (sent == 0 || received == 0))) {
+            continue;
+          }
+          all[c].push_back(values[c]);
+          per_hop[hop][c].push_back(values[c]);
+        }
+      }
+    }
+
+    out << "Hop latency breakdown over " << msgids.size() << " messages, us (P50/P90):\n";
+    out << std::setw(6) << "hop";
+    for (const char* name : kComponentNames) {
+      out << std::setw(16) << name;
+    }
+    out << "\n";
+    for (int hop = 0; hop < kNumHops; ++hop) {
+      out << std::setw(6) << hop;
+      for (auto& values : per_hop[hop]) {
+        print_p50_p90(out, values);
+      }
+      out << "\n";
+    }
+    out << std::setw(6) << "all";
+    for (auto& values : all) {
+      print_p50_p90(out, values);
+    }
+    out << "\n\n";
+  }
+
+ private:
+  static constexpr int kNumComponents = 4;
+  static constexpr const char* kComponentNames[kNumComponents] = {"middleware", "queueing",
+                                                                  "dispatch", "callback"};
+
+  HopStamps& slot(int64_t msgid, int hop) { return stamps_[msgid % kCapacity][hop]; }
+  const HopStamps& slot(int64_t msgid, int hop) const { return stamps_[msgid % kCapacity][hop]; }
+
+  static void print_p50_p90(std::ostream& out, std::vector<int64_t>& values) {
+    if (values.empty()) {
+      out << std::setw(16) << "-";
+      return;
+    }
+    std::sort(values.begin(), values.end());
+    int64_t p50 = values[values.size() / 2] / 1000;
+    int64_t p90 = values[values.size() * 9 / 10] / 1000;
+    out << std::setw(16) << (std::to_string(p50) + "/" + std::to_string(p90));
+  }
+
+  std::vector<std::array<HopStamps, kNumHops>> stamps_;
+  mutable std::mutex mutex_;
+  std::vector<int64_t> completed_;
+};
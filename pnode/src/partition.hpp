@@ -0,0 +1,146 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "benchcore/flags.hpp"
+#include "benchcore/process.hpp"
+#include "benchcore/sweep.hpp"
+#include "rclcpp/rclcpp.hpp"
+
+// The callback group of the relays' subscriptions, from
+// --relay-group=default|exclusive|reentrant. default is the node's default
+// group, which is mutually exclusive and shared with the node's timers.
+// exclusive and reentrant are a group of their own of that type. Returns
+// nullopt for default.
+inline std::optional<rclcpp::CallbackGroupType> relay_group_type(const benchcore::Flags& flags) {
+  std::string group = flags.get("relay-group", "default");
+  if (group == "default") {
+    return std::nullopt;
+  }
+  if (group == "exclusive") {
+    return rclcpp::CallbackGroupType::MutuallyExclusive;
+  }
+  if (group == "reentrant") {
+    return rclcpp::CallbackGroupType::Reentrant;
+  }
+  throw std::invalid_argument("unknown relay group: " + group);
+}
+
+// Which of --partitions=K executors spins each node. Nodes are numbered in
+// chain order: the source is 0, relay n is n + 1 and the sink is last.
+// --partition-map selects the mapping:
+//   block        consecutive nodes together, K equal blocks (default)
+//   round-robin  node i on executor i % K, so every hop changes executor
+//   0,0,1,...    the executor of every node, in chain order
+// The same mappings assign a lowlatency executor's nodes to its workers with
+// --exec-affinity.
+class Partitioning {
+ public:
+  Partitioning(const benchcore::Flags& flags, int num_nodes)
+      : Partitioning(std::max<int64_t>(1, flags.get_int("partitions", 1)),
+                     flags.get("partition-map", "block"), num_nodes) {}
+
+  Partitioning(int partitions, const std::string& map, int num_nodes)
+      : partitions_(std::max(1, partitions)), num_nodes_(num_nodes), map_(map) {
+    if (map_ == "block" || map_ == "round-robin") {
+      return;
+    }
+    for (const std::string& partition : benchcore::split(map_)) {
+      explicit_.push_back(std::stoi(partition));
+      if (explicit_.back() < 0 || explicit_.back() >= partitions_) {
+        throw std::invalid_argument("partition out of range in " + map_ + ": " + partition);
+      }
+    }
+    if (static_cast<int>(explicit_.size()) != num_nodes_) {
+      throw std::invalid_argument(map_ + " needs " + std::to_string(num_nodes_) +
+                                  " entries, one per node in chain order");
+    }
+  }
+
+  int partitions() const { return partitions_; }
+  int of(int node) const {
+    if (!explicit_.empty()) {
+      return explicit_[node];
+    }
+    if (map_ == "round-robin") {
+      return node % partitions_;
+    }
+    return static_cast<int64_t>(node) * partitions_ / num_nodes_;
+  }
+
+ private:
+  int partitions_;
+  int num_nodes_;
+  std::string map_;
+  std::vector<int> explicit_;
+};
+
+// With --partition-sweep=1,2,4, runs pnode once per executor count, mapping
+// in --sweep-maps (default block,round-robin) and relay group in
+// --sweep-groups (default default,reentrant), and prints P50 and P90 as a
+// heatmap: a row per mapping and group, a column per executor count, and
+// every cell shaded by its P90 between the lowest and the highest. Other
+// flags, e.g. --executor and --exec-threads for each of the executors, are
+// passed on to every run.
+inline int run_partition_sweep(const benchcore::Flags& flags) {
+  std::vector<std::string> counts = benchcore::split(flags.get("partition-sweep"));
+  std::vector<std::string> maps = benchcore::split(flags.get("sweep-maps", "block,round-robin"));
+  std::vector<std::string> groups =
+      benchcore::split(flags.get("sweep-groups", "default,reentrant"));
+  std::vector<std::string> names;
+  std::vector<benchcore::SweepCase> cases;
+  for (const std::string& map : maps) {
+    for (const std::string& group : groups) {
+      names.push_back(map + ", " + group);
+      for (const std::string& count : counts) {
+        cases.push_back({count + " executors, " + map + ", " + group + " relay group",
+                         {"--partitions=" + count, "--partition-map=" + map,
+                          "--relay-group=" + group}});
+      }
+    }
+  }
+  std::vector<benchcore::SweepRun> runs = benchcore::run_sweep(
+      flags, {"--partition", "--relay-group"}, cases, std::chrono::seconds(120));
+
+  int64_t lowest = -1;
+  int64_t highest = -1;
+  for (const benchcore::SweepRun& run : runs) {
+    if (run.stats.ok()) {
+      lowest = lowest < 0 ? run.stats.p90_us : std::min(lowest, run.stats.p90_us);
+      highest = std::max(highest, run.stats.p90_us);
+    }
+  }
+  static const char* kShades[] = {"░", "▒", "▓", "█"};
+  std::vector<std::string> columns = {"Mapping, relay group"};
+  for (const std::string& count : counts) {
+    columns.push_back(count + (count == "1" ? " executor" : " executors"));
+  }
+  std::vector<std::vector<std::string>> rows;
+  for (size_t row = 0; row < names.size(); ++row) {
+    std::vector<std::string> cells = {names[row]};
+    for (size_t column = 0; column < counts.size(); ++column) {
+      const benchcore::LatencyStats& stats = runs[row * counts.size() + column].stats;
+      if (!stats.ok()) {
+        cells.push_back(stats.error);
+        continue;
+      }
+      int shade = highest > lowest ? (stats.p90_us - lowest) * 4 / (highest - lowest + 1) : 0;
+      cells.push_back(std::to_string(stats.p50_us) + "/" + std::to_string(stats.p90_us) + " " +
+                      kShades[shade]);
+    }
+    rows.push_back(std::move(cells));
+  }
+  benchcore::print_sweep_table(
+      std::cout,
+      std::string("Partition sweep, P50/P90 in us/hop, shaded by P90 from ") + kShades[0] + " (" +
+          std::to_string(lowest) + "us) to " + kShades[3] + " (" + std::to_string(highest) +
+          "us):",
+      columns, rows);
+  return 0;
+}
@@ -1,135 +1,786 @@
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <functional>
 #include <iostream>
 #include <memory>
-#include <set>
+#include <optional>
+#include <stdexcept>
+#include <string>
 #include <thread>
 #include <vector>
 
+#include "benchcore/batch.hpp"
+#include "benchcore/bulk.hpp"
+#include "benchcore/chain.hpp"
+#include "benchcore/clock.hpp"
+#include "benchcore/flags.hpp"
+#include "benchcore/idle.hpp"
+#include "benchcore/jitter.hpp"
+#include "benchcore/memory.hpp"
+#include "benchcore/report.hpp"
+#include "benchcore/scale.hpp"
+#include "benchcore/soak.hpp"
+#include "benchcore/traffic.hpp"
+#include "benchcore/warmup.hpp"
+#include "hop_trace.hpp"
+#include "partition.hpp"
+#include "pexec/executors.hpp"
+#include "pexec/low_latency_executor.hpp"
 #include "pnodeif/msg/timing.hpp"
+#include "pnodeif/msg/timing_batch.hpp"
+#include "qos_sweep.hpp"
 #include "rclcpp/rclcpp.hpp"
 #include "rclcpp_components/register_node_macro.hpp"
+#include "traced_executor.hpp"
 
 using namespace std::chrono_literals;
-constexpr int kNumRelays = 20;
+using benchcore::kNumRelays;
+
+// Per-hop timestamps for the relays and the sink, with --trace-hops.
+using PnodeHopTrace = HopTrace<kNumRelays + 1>;
 
 // Helper function that returns a QoS to use everywhere.
 // This makes it easier to measure impact of QoS policies on timing.
-rclcpp::QoS get_qos() {
-  rclcpp::QoS qos(rclcpp::KeepLast(10));
-  qos.reliability(rclcpp::ReliabilityPolicy::Reliable);
-  qos.durability(rclcpp::DurabilityPolicy::TransientLocal);
+// Without flags it's KeepLast(10), Reliable, TransientLocal. The flags are
+// --reliability=reliable|best_effort, --durability=transient_local|volatile,
+// --depth=N, --deadline-ms=N and --lifespan-ms=N.
+rclcpp::QoS get_qos(const benchcore::Flags& flags) {
+  rclcpp::QoS qos(rclcpp::KeepLast(flags.get_int("depth", 10)));
+  std::string reliability = flags.get("reliability", "reliable");
+  if (reliability == "reliable") {
+    qos.reliability(rclcpp::ReliabilityPolicy::Reliable);
+  } else if (reliability == "best_effort") {
+    qos.reliability(rclcpp::ReliabilityPolicy::BestEffort);
+  } else {
+    throw std::invalid_argument("unknown reliability: " + reliability);
+  }
+  std::string durability = flags.get("durability", "transient_local");
+  if (durability == "transient_local") {
+    qos.durability(rclcpp::DurabilityPolicy::TransientLocal);
+  } else if (durability == "volatile") {
+    qos.durability(rclcpp::DurabilityPolicy::Volatile);
+  } else {
+    throw std::invalid_argument("unknown durability: " + durability);
+  }
+  if (flags.has("deadline-ms")) {
+    qos.deadline(rclcpp::Duration(std::chrono::milliseconds(flags.get_int("deadline-ms", 0))));
+  }
+  if (flags.has("lifespan-ms")) {
+    qos.lifespan(rclcpp::Duration(std::chrono::milliseconds(flags.get_int("lifespan-ms", 0))));
+  }
   return qos;
 }
 
+// Counters shared by the source and the sink.
+struct RunState {
+  std::atomic<int64_t> published{0};
+  std::atomic<int64_t> last_published_ns{0};
+  // Requested deadlines missed, summed over all subscriptions.
+  std::atomic<int64_t> deadline_missed{0};
+};
+
+// How the chain runs. The defaults are the original benchmark: publish every
+// 1ms until the sink has 1000 samples.
+struct PnodeConfig {
+  rclcpp::QoS qos{rclcpp::KeepLast(10)};
+  bool deadline = false;
+  std::chrono::nanoseconds period = 1ms;
+  std::string payload = "pnode publisher";
+  // With messages > 0, the source stops after that many, and the sink
+  // reports once it received them all, or kDrainTimeout after the last one
+  // was published, with the number of dropped messages.
+  int64_t messages = 0;
+  // With --warmup, the source sends up to warmup_messages more, and the sink
+  // drops the first ones.
+  int64_t warmup_messages = 0;
+  // Relays per chain, and the number of parallel chains between the source
+  // and the sink. Every message goes through each chain, so the sink gets
+  // width copies of it. With fan_out, the chains share the source's topic,
+  // otherwise the source publishes to each chain's topic in turn.
+  int num_relays = kNumRelays;
+  int width = 1;
+  bool fan_out = false;
+  // With --batch-size, the source and the relays publish TimingBatch
+  // messages instead.
+  benchcore::BatchConfig batch;
+  // With --traffic, when the source publishes. The mean is the period.
+  benchcore::TrafficShape traffic;
+  PnodeHopTrace* trace = nullptr;
+  RunState* state = nullptr;
+  benchcore::StartupReport* startup = nullptr;
+  // With --source-jitter, how late the source's timer runs.
+  benchcore::LatenessHistogram* source_lateness = nullptr;
+  // With --bulk-size, a bulk chain runs through the first chain's relays.
+  benchcore::BulkConfig bulk;
+  // Where the sink passes every message, bulk ones included.
+  benchcore::LatencyRecorder* recorder = nullptr;
+  // With --relay-group, the type of the relays' own callback groups,
+  // otherwise they subscribe in the node's default group.
+  std::optional<rclcpp::CallbackGroupType> relay_group;
+};
+
+constexpr std::chrono::seconds kDrainTimeout{2};
+// How long --startup waits for discovery before it reports it as timed out.
+constexpr std::chrono::seconds kDiscoveryTimeout{120};
+
+// The config from --rate-hz, --payload-size, --messages, --warmup, --relays,
+// --width, --fan-out, the batch, traffic and bulk flags, --relay-group, plus
+// the QoS flags of get_qos().
+PnodeConfig make_config(const benchcore::Flags& flags, RunState* state) {
+  PnodeConfig config;
+  config.qos = get_qos(flags);
+  config.deadline = flags.has("deadline-ms");
+  if (flags.has("rate-hz")) {
+    config.period = std::chrono::nanoseconds(
+        static_cast<int64_t>(1e9 / flags.get_double("rate-hz", 1000)));
+  }
+  if (flags.has("payload-size")) {
+    config.payload = std::string(flags.get_int("payload-size", 0), 'x');
+  }
+  config.messages = flags.get_int("messages", 0);
+  config.warmup_messages = benchcore::Warmup::extra_messages(flags);
+  config.num_relays = flags.get_int("relays", kNumRelays);
+  config.width = flags.get_int("width", 1);
+  config.fan_out = flags.get_bool("fan-out");
+  config.batch = benchcore::BatchConfig::from_flags(flags);
+  config.traffic = benchcore::TrafficShape::from_flags(flags, config.period);
+  if (!config.traffic.uniform() && config.batch.enabled()) {
+    throw std::invalid_argument("--traffic doesn't work with --batch-size");
+  }
+  config.bulk = benchcore::BulkConfig::from_flags(flags);
+  config.relay_group = relay_group_type(flags);
+  if (config.relay_group == rclcpp::CallbackGroupType::Reentrant && config.batch.enabled()) {
+    throw std::invalid_argument("--relay-group=reentrant doesn't work with --batch-size");
+  }
+  config.state = state;
+  return config;
+}
+
+// The topic into hop `hop` of chain `chain`. With several chains, each has
+// topics of its own, the sink's included, so the sink can tell them apart.
+// Only with fan_out do they share the source's topic.
+std::string topic_name(const PnodeConfig& config, int chain, int hop) {
+  if (config.width == 1 || (hop == 0 && config.fan_out)) {
+    return "msg_" + std::to_string(hop);
+  }
+  return "msg_" + std::to_string(chain) + "_" + std::to_string(hop);
+}
+
+// The bulk chain's topic into hop `hop`.
+std::string bulk_topic_name(int hop) { return "bulk_" + std::to_string(hop); }
+
+// Counts missed deadlines when a deadline is set.
+rclcpp::SubscriptionOptions subscription_options(const PnodeConfig& config) {
+  rclcpp::SubscriptionOptions options;
+  if (config.deadline) {
+    RunState* state = config.state;
+    options.event_callbacks.deadline_callback = [state](rclcpp::QOSDeadlineRequestedInfo& info) {
+      state->deadline_missed += info.total_count_change;
+    };
+  }
+  return options;
+}
+
+// Publishes Timing messages one at a time, or with --batch-size coalesced
+// into TimingBatch messages. A batch goes out when it's full, and whatever
+// is pending every --flush-us. The flush timer is in the node's default
+// callback group, so it doesn't run concurrently with the node's other
+// callbacks.
+class TimingPublisher {
+ public:
+  TimingPublisher(rclcpp::Node* node, const std::string& topic, const PnodeConfig& config)
+      : batcher_(config.batch.size) {
+    if (config.batch.enabled()) {
+      batch_publisher_ = node->create_publisher<pnodeif::msg::TimingBatch>(topic, config.qos);
+      flush_timer_ = node->create_wall_timer(config.batch.flush_interval, [this]() {
+        if (!batcher_.empty()) {
+          flush();
+        }
+      });
+    } else {
+      publisher_ = node->create_publisher<pnodeif::msg::Timing>(topic, config.qos);
+    }
+  }
+  void publish(const pnodeif::msg::Timing& msg) {
+    if (publisher_) {
+      publisher_->publish(msg);
+    } else if (batcher_.add(msg)) {
+      flush();
+    }
+  }
+  size_t get_subscription_count() const {
+    return publisher_ ? publisher_->get_subscription_count()
+                      : batch_publisher_->get_subscription_count();
+  }
+
+ private:
+  void flush() {
+    pnodeif::msg::TimingBatch batch;
+    batch.messages = batcher_.take();
+    batch_publisher_->publish(batch);
+  }
+
+  benchcore::Batcher<pnodeif::msg::Timing> batcher_;
+  std::shared_ptr<rclcpp::Publisher<pnodeif::msg::Timing>> publisher_;
+  std::shared_ptr<rclcpp::Publisher<pnodeif::msg::TimingBatch>> batch_publisher_;
+  std::shared_ptr<rclcpp::TimerBase> flush_timer_;
+};
+
+using TimingCallback =
+    std::function<void(const pnodeif::msg::Timing&, const rclcpp::MessageInfo&)>;
+
+// Subscribes to Timing messages, or with --batch-size to TimingBatch
+// messages, and calls `callback` for each Timing. `on_receive`, if set, gets
+// the number of messages in each delivery. The subscription is in `group`,
+// or the node's default group.
+rclcpp::SubscriptionBase::SharedPtr subscribe_timing(
+    rclcpp::Node* node, const std::string& topic, const PnodeConfig& config,
+    TimingCallback callback, std::function<void(size_t)> on_receive = nullptr,
+    rclcpp::CallbackGroup::SharedPtr group = nullptr) {
+  rclcpp::SubscriptionOptions options = subscription_options(config);
+  options.callback_group = group;
+  if (!config.batch.enabled()) {
+    return node->create_subscription<pnodeif::msg::Timing>(
+        topic, config.qos,
+        [callback, on_receive](const pnodeif::msg::Timing& msg, const rclcpp::MessageInfo& info) {
+          if (on_receive) {
+            on_receive(1);
+          }
+          callback(msg, info);
+        },
+        options);
+  }
+  return node->create_subscription<pnodeif::msg::TimingBatch>(
+      topic, config.qos,
+      [callback, on_receive](const pnodeif::msg::TimingBatch& batch,
+                             const rclcpp::MessageInfo& info) {
+        if (on_receive) {
+          on_receive(batch.messages.size());
+        }
+        for (const pnodeif::msg::Timing& msg : batch.messages) {
+          callback(msg, info);
+        }
+      },
+      options);
+}
+
+// Subscribes a node to the bulk chain. With --bulk-isolation=isolated the
+// subscription is in a callback group of its own, which main() spins on an
+// executor of its own. Otherwise it's in the node's default group, so it
+// takes turns with the measured chain's subscription. Returns the group, or
+// nullptr.
+rclcpp::CallbackGroup::SharedPtr subscribe_bulk(
+    rclcpp::Node* node, int hop, const PnodeConfig& config,
+    std::function<void(const pnodeif::msg::Timing&)> callback,
+    rclcpp::SubscriptionBase::SharedPtr* subscription) {
+  rclcpp::SubscriptionOptions options;
+  if (config.bulk.enabled() && config.bulk.isolated) {
+    options.callback_group =
+        node->create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive, false);
+  }
+  *subscription = node->create_subscription<pnodeif::msg::Timing>(
+      bulk_topic_name(hop), config.qos, callback, options);
+  return options.callback_group;
+}
+
 // The source to generate messages.
 class PnodeSource : public rclcpp::Node {
  public:
-  PnodeSource(const rclcpp::NodeOptions&) : Node("source"), msgid_(0) {
-    publisher_ = this->create_publisher<pnodeif::msg::Timing>("msg_0", get_qos());
-    timer_ = this->create_wall_timer(1ms, [this]() { publish(); });
+  PnodeSource(const rclcpp::NodeOptions&, const PnodeConfig& config)
+      : Node("source"), config_(config), msgid_(0) {
+    int topics = config_.fan_out ? 1 : config_.width;
+    for (int chain = 0; chain < topics; ++chain) {
+      publishers_.push_back(
+          std::make_unique<TimingPublisher>(this, topic_name(config_, chain, 0), config_));
+    }
+    if (config_.bulk.enabled()) {
+      bulk_publisher_ =
+          this->create_publisher<pnodeif::msg::Timing>(bulk_topic_name(0), config_.qos);
+    }
+    if (config_.traffic.uniform()) {
+      if (config_.source_lateness) {
+        lateness_ = std::make_unique<benchcore::PeriodicLateness>(config_.period,
+                                                                  config_.source_lateness);
+      }
+      timer_ = this->create_wall_timer(config_.period, [this]() { publish(); });
+      return;
+    }
+    // Other traffic shapes publish from a thread on their own schedule,
+    // started once the executor runs the timer. --source-jitter then measures
+    // how late the thread wakes up for each scheduled message.
+    timer_ = this->create_wall_timer(config_.period, [this]() {
+      timer_->cancel();
+      thread_ = std::thread([this]() {
+        benchcore::Pacer pacer(config_.traffic, config_.period);
+        while (!done_) {
+          publish();
+          pacer.wait();
+          if (config_.source_lateness && !done_) {
+            config_.source_lateness->add(std::chrono::nanoseconds(
+                std::chrono::steady_clock::now() - pacer.scheduled()).count());
+          }
+        }
+      });
+    });
+  }
+  ~PnodeSource() override {
+    done_ = true;
+    if (thread_.joinable()) {
+      thread_.join();
+    }
   }
   void publish() {
+    if (config_.messages > 0 && msgid_ >= config_.messages + config_.warmup_messages) {
+      timer_->cancel();
+      done_ = true;
+      return;
+    }
+    if (lateness_) {
+      lateness_->tick();
+    }
     pnodeif::msg::Timing t;
     t.msgid = ++msgid_;
-    t.nanosec = std::chrono::duration_cast<std::chrono::nanoseconds>(
-                    std::chrono::steady_clock::now().time_since_epoch())
-                    .count();
-    t.source = "pnode publisher";
-    publisher_->publish(t);
+    t.source = config_.payload;
+    // Every chain's latency starts at its own publish.
+    for (auto& publisher : publishers_) {
+      t.nanosec = benchcore::now_ns();
+      publisher->publish(t);
+    }
+    config_.state->published++;
+    config_.state->last_published_ns = benchcore::now_ns();
     // std::cout << t.source << "\n";
   }
+  // Called by the BulkSource's thread.
+  void publish_bulk(int64_t msgid, const std::string& payload) {
+    pnodeif::msg::Timing t;
+    t.msgid = msgid;
+    t.source = payload;
+    t.nanosec = benchcore::now_ns();
+    bulk_publisher_->publish(t);
+  }
 
  private:
-  std::shared_ptr<rclcpp::Publisher<pnodeif::msg::Timing>> publisher_;
+  PnodeConfig config_;
+  // One per chain, or one for all of them with fan_out.
+  std::vector<std::unique_ptr<TimingPublisher>> publishers_;
+  std::shared_ptr<rclcpp::Publisher<pnodeif::msg::Timing>> bulk_publisher_;
   std::shared_ptr<rclcpp::TimerBase> timer_;
+  std::unique_ptr<benchcore::PeriodicLateness> lateness_;
   int64_t msgid_;
+  std::atomic<bool> done_{false};
+  std::thread thread_;
 };
 
 // The relay to pass on messages.
 class PnodeRelay : public rclcpp::Node {
  public:
-  PnodeRelay(const rclcpp::NodeOptions& options)
-      : Node("relay_" + options.arguments()[0]), index_(std::stoi(options.arguments()[0])) {
-    publisher_ = this->create_publisher<pnodeif::msg::Timing>("msg_" + std::to_string(index_ + 1),
-                                                              get_qos());
-    subscriber_ = this->create_subscription<pnodeif::msg::Timing>(
-        "msg_" + std::to_string(index_), get_qos(),
-        [this](const pnodeif::msg::Timing& msg) { listen(msg); });
-  }
-  void listen(const pnodeif::msg::Timing& msg) {
+  // The arguments are the relay's index, and its chain if there are several.
+  PnodeRelay(const rclcpp::NodeOptions& options, const PnodeConfig& config)
+      : Node(options.arguments().size() > 1
+                 ? "relay_" + options.arguments()[1] + "_" + options.arguments()[0]
+                 : "relay_" + options.arguments()[0]),
+        index_(std::stoi(options.arguments()[0])),
+        trace_(config.trace) {
+    int chain = options.arguments().size() > 1 ? std::stoi(options.arguments()[1]) : 0;
+    publisher_ = std::make_unique<TimingPublisher>(this, topic_name(config, chain, index_ + 1),
+                                                   config);
+    rclcpp::CallbackGroup::SharedPtr group;
+    if (config.relay_group) {
+      group = this->create_callback_group(*config.relay_group);
+    }
+    subscriber_ = subscribe_timing(
+        this, topic_name(config, chain, index_), config,
+        [this](const pnodeif::msg::Timing& msg, const rclcpp::MessageInfo& info) {
+          listen(msg, info);
+        },
+        nullptr, group);
+    if (config.bulk.enabled() && chain == 0) {
+      bulk_publisher_ =
+          this->create_publisher<pnodeif::msg::Timing>(bulk_topic_name(index_ + 1), config.qos);
+      bulk_group_ = subscribe_bulk(
+          this, index_, config,
+          [this](const pnodeif::msg::Timing& msg) { bulk_publisher_->publish(msg); },
+          &bulk_subscriber_);
+    }
+  }
+  void listen(const pnodeif::msg::Timing& msg, const rclcpp::MessageInfo& info) {
+    if (trace_) {
+      trace_->on_callback(msg.msgid, index_, info, TracedExecutor::picked_time());
+    }
     pnodeif::msg::Timing copy = msg;
     copy.source = "pnode relay " + std::to_string(index_);
     publisher_->publish(msg);
     // std::cout << copy.source << "\n";
+    if (trace_) {
+      trace_->on_published(msg.msgid, index_);
+    }
   }
   int index() const { return index_; }
+  rclcpp::CallbackGroup::SharedPtr bulk_group() const { return bulk_group_; }
+  // Whether discovery matched both ends of this relay.
+  bool matched() const {
+    return publisher_->get_subscription_count() > 0 && subscriber_->get_publisher_count() > 0;
+  }
 
  private:
   int index_;
-  std::shared_ptr<rclcpp::Publisher<pnodeif::msg::Timing>> publisher_;
-  std::shared_ptr<rclcpp::Subscription<pnodeif::msg::Timing>> subscriber_;
+  PnodeHopTrace* trace_;
+  std::unique_ptr<TimingPublisher> publisher_;
+  rclcpp::SubscriptionBase::SharedPtr subscriber_;
+  std::shared_ptr<rclcpp::Publisher<pnodeif::msg::Timing>> bulk_publisher_;
+  rclcpp::SubscriptionBase::SharedPtr bulk_subscriber_;
+  rclcpp::CallbackGroup::SharedPtr bulk_group_;
 };
 
-// The sink to complete the final hop and calculate timing.
+// With --messages, what the sink reports after the latency stats: the
+// messages it didn't get, the missed deadlines and the memory. Every chain
+// delivers each message once, its distinct msgids are what it received.
+// With several chains, the average of them.
+void print_drops(std::ostream& out, const PnodeConfig& config,
+                 benchcore::LatencyRecorder& recorder) {
+  int64_t published = config.state->published;
+  int64_t completions = 0;
+  for (int chain = 0; chain < config.width; ++chain) {
+    completions += recorder.received(chain);
+  }
+  out << "Received ";
+  if (config.width == 1) {
+    out << completions << " of " << published << " messages, " << published - completions
+        << " dropped.\n";
+  } else {
+    double received = static_cast<double>(completions) / config.width;
+    out << received << " of " << published << " messages, " << published - received
+        << " dropped, per chain on average.\n";
+  }
+  if (config.deadline) {
+    out << "Deadline missed: " << config.state->deadline_missed << "\n";
+  }
+  out << "Memory: RSS " << benchcore::proc_status_kb("VmRSS") / 1024 << " MB, peak RSS "
+      << benchcore::proc_status_kb("VmHWM") / 1024 << " MB\n\n";
+}
+
+// The sink to complete the final hop, passing every message to the
+// recorder. With several chains, it subscribes to each chain's last topic,
+// and takes width copies of every message.
 class PnodeSink : public rclcpp::Node {
  public:
-  PnodeSink(const rclcpp::NodeOptions&) : Node("sink") {
-    subscriber_ = this->create_subscription<pnodeif::msg::Timing>(
-        "msg_" + std::to_string(kNumRelays), get_qos(),
-        [this](const pnodeif::msg::Timing& msg) { listen(msg); });
-  }
-  void listen(const pnodeif::msg::Timing& msg) {
-    int64_t nanosec = std::chrono::duration_cast<std::chrono::nanoseconds>(
-                          std::chrono::steady_clock::now().time_since_epoch())
-                          .count();
-    int64_t nanosec_per_hop = (nanosec - msg.nanosec) / (kNumRelays + 1);
-    data_.insert(nanosec_per_hop);
-    // std::cout << "nano seconds per hop: " << nanosec_per_hop << "\n";
-
-    if (data_.size() >= 1000) {
-      print_stats();
-      exit(0);
-    }
-  }
-  void print_stats() {
-    std::vector<int64_t> array(data_.cbegin(), data_.cend());
-    std::sort(array.begin(), array.end());
-    int p50_index = array.size() / 2;
-    int p90_index = array.size() * 9 / 10;
-    std::cout << "\nStats with " << array.size() << " data points, ns/hop:"
-              << "\nP50 = " << array[p50_index] / 1000 << "us, P90 = " << array[p90_index] / 1000
-              << "us\n\n";
+  PnodeSink(const rclcpp::NodeOptions&, const PnodeConfig& config)
+      : Node("sink"),
+        config_(config),
+        trace_(config.trace),
+        recorder_(config.recorder),
+        arrived_ns_(config.width) {
+    for (int chain = 0; chain < config_.width; ++chain) {
+      subscribers_.push_back(subscribe_timing(
+          this, topic_name(config_, chain, config_.num_relays), config_,
+          [this, chain](const pnodeif::msg::Timing& msg, const rclcpp::MessageInfo& info) {
+            listen(msg, info, chain);
+          },
+          [this, chain](size_t messages) { arrived_ns_[chain] = recorder_->arrived(messages); }));
+    }
+    if (config_.messages > 0) {
+      drain_timer_ = this->create_wall_timer(100ms, [this]() { check_drained(); });
+    }
+    if (config_.bulk.enabled()) {
+      bulk_group_ = subscribe_bulk(
+          this, config_.num_relays, config_,
+          [this](const pnodeif::msg::Timing& msg) { recorder_->record_bulk(msg.nanosec); },
+          &bulk_subscriber_);
+    }
+  }
+  void listen(const pnodeif::msg::Timing& msg, const rclcpp::MessageInfo& info, int chain) {
+    std::array<int64_t, PnodeHopTrace::kStamps> stamps;
+    if (trace_) {
+      trace_->on_callback(msg.msgid, kNumRelays, info, TracedExecutor::picked_time());
+      trace_->on_complete(msg.msgid);
+      trace_->stamps(msg.msgid, stamps.data());
+    }
+    recorder_->record(msg.msgid, msg.nanosec, arrived_ns_[chain], chain,
+                      trace_ ? stamps.data() : nullptr);
+  }
+  // With a fixed number of messages, stops waiting for the ones dropped.
+  void check_drained() {
+    const RunState& state = *config_.state;
+    if (state.published == config_.messages + config_.warmup_messages &&
+        benchcore::now_ns() - state.last_published_ns >
+            std::chrono::nanoseconds(kDrainTimeout).count()) {
+      recorder_->finish();
+    }
   }
+  bool matched() const {
+    for (const auto& subscriber : subscribers_) {
+      if (subscriber->get_publisher_count() == 0) {
+        return false;
+      }
+    }
+    return true;
+  }
+  rclcpp::CallbackGroup::SharedPtr bulk_group() const { return bulk_group_; }
 
  private:
-  std::shared_ptr<rclcpp::Subscription<pnodeif::msg::Timing>> subscriber_;
-  std::unordered_multiset<int64_t> data_;
+  PnodeConfig config_;
+  PnodeHopTrace* trace_;
+  benchcore::LatencyRecorder* recorder_;
+  // One per chain.
+  std::vector<rclcpp::SubscriptionBase::SharedPtr> subscribers_;
+  // When each chain's current delivery arrived. A subscription's callbacks
+  // don't overlap, so each chain's is only used by its own.
+  std::vector<int64_t> arrived_ns_;
+  rclcpp::SubscriptionBase::SharedPtr bulk_subscriber_;
+  rclcpp::CallbackGroup::SharedPtr bulk_group_;
+  std::shared_ptr<rclcpp::TimerBase> drain_timer_;
 };
 
 int main(int argc, char* argv[]) {
   rclcpp::init(argc, argv);
+  benchcore::Flags flags(rclcpp::remove_ros_arguments(argc, argv));
+  // With --qos-sweep, run this binary once per QoS combination instead.
+  if (flags.get_bool("qos-sweep")) {
+    int status = run_qos_sweep(flags);
+    rclcpp::shutdown();
+    return status;
+  }
+  // With --batch-sweep=1,8,64, run this binary once per batch size.
+  if (flags.has("batch-sweep")) {
+    int status = benchcore::run_batch_sweep(flags);
+    rclcpp::shutdown();
+    return status;
+  }
+  // With --scale-sweep=100,1000,..., run this binary once per relay count.
+  if (flags.has("scale-sweep")) {
+    int status = benchcore::run_scale_sweep(flags);
+    rclcpp::shutdown();
+    return status;
+  }
+  // With --partition-sweep=1,2,4, run this binary once per executor count,
+  // partition mapping and relay group.
+  if (flags.has("partition-sweep")) {
+    int status = run_partition_sweep(flags);
+    rclcpp::shutdown();
+    return status;
+  }
+  // With --bulk-sweep, run it alone and next to a shared and an isolated bulk
+  // chain.
+  if (flags.get_bool("bulk-sweep")) {
+    int status = benchcore::run_bulk_sweep(flags);
+    rclcpp::shutdown();
+    return status;
+  }
+  // With --executor-sweep, run this binary once per executor.
+  if (flags.has("executor-sweep")) {
+    int status = pexec::run_executor_sweep(flags);
+    rclcpp::shutdown();
+    return status;
+  }
+  benchcore::init_clock(flags);
+  RunState state;
+  PnodeConfig config = make_config(flags, &state);
+
+  // With --trace-hops, the relays and the sink record per-hop timestamps, and
+  // the sink prints a breakdown of where each hop spends its time.
+  std::unique_ptr<PnodeHopTrace> trace;
+  if (flags.get_bool("trace-hops")) {
+    if (config.num_relays != kNumRelays || config.width != 1 || config.batch.enabled()) {
+      throw std::invalid_argument("--trace-hops needs the default chain, unbatched");
+    }
+    if (flags.has("executor")) {
+      throw std::invalid_argument(
+          "--trace-hops runs its own multi-threaded executor, it doesn't work with --executor");
+    }
+    trace = std::make_unique<PnodeHopTrace>();
+    benchcore::add_report_section([&trace](std::ostream& out) { trace->print(out); });
+    config.trace = trace.get();
+  }
+
+  // With --source-jitter, report how late the source's timer published each
+  // message, which is not part of the measured latency.
+  std::unique_ptr<benchcore::LatenessHistogram> source_lateness;
+  if (flags.get_bool("source-jitter")) {
+    source_lateness = std::make_unique<benchcore::LatenessHistogram>("pnode source timer");
+    benchcore::add_report_section(
+        [&source_lateness](std::ostream& out) { source_lateness->print(out); });
+    config.source_lateness = source_lateness.get();
+  }
+
+  // With --soak-minutes, run that long with rolling latency windows, see
+  // benchcore/soak.hpp.
+  if (benchcore::soak_requested(flags) && (config.messages > 0 || trace)) {
+    throw std::invalid_argument("--soak-minutes doesn't work with --messages or --trace-hops");
+  }
+
+  // With --memmon, sample memory from before the nodes are created.
+  int num_nodes = config.num_relays * config.width;
+  auto memory =
+      benchcore::MemorySampler::from_flags(flags, num_nodes + 2, config.payload.size());
+
+  // With --relays or --width, or --startup, time node creation, discovery
+  // and the first message at the sink.
+  std::unique_ptr<benchcore::StartupReport> startup;
+  if (flags.has("relays") || flags.has("width") || flags.get_bool("startup")) {
+    startup = std::make_unique<benchcore::StartupReport>(num_nodes + 2);
+    config.startup = startup.get();
+  }
+
+  // The sink's stats, and with --capture=FILE, --warmup, --soak-minutes or
+  // --bulk-size everything else it does with the messages, see
+  // benchcore/chain.hpp. msgids start at 1, and every chain delivers each.
+  benchcore::RecorderOptions recorder_options;
+  recorder_options.num_relays = config.num_relays;
+  recorder_options.chains = config.width;
+  recorder_options.first_msgid = 1;
+  recorder_options.period = config.period;
+  if (config.messages > 0) {
+    recorder_options.messages = config.messages;
+  }
+  recorder_options.stamps = trace ? PnodeHopTrace::kStamps : 0;
+  recorder_options.startup = config.startup;
+  std::unique_ptr<benchcore::LatencyRecorder> recorder;
+  if (config.messages > 0) {
+    recorder_options.print_extra = [&config, &recorder](std::ostream& out) {
+      print_drops(out, config, *recorder);
+    };
+  }
+  recorder = std::make_unique<benchcore::LatencyRecorder>(flags, std::move(recorder_options));
+  config.recorder = recorder.get();
 
   // Create the nodes, and keep them alive by holding the shared_ptrs here.
-  rclcpp::NodeOptions node_options;
-  std::cout << "Creating nodes ... ";
-  auto source = std::make_shared<PnodeSource>(node_options);
-  std::vector<std::shared_ptr<PnodeRelay>> relays;
-  for (int i = 0; i < kNumRelays; ++i) {
-    std::cout << i << ", ";
-    node_options.arguments({std::to_string(i)});
-    relays.push_back(std::make_shared<PnodeRelay>(node_options));
-  }
-  auto sink = std::make_shared<PnodeSink>(node_options);
-
-  // Use a multi-threaded executor to spin all nodes.
-  rclcpp::executors::MultiThreadedExecutor executor;
-  executor.add_node(source);
-  for (auto& relay : relays) {
-    executor.add_node(relay);
-  }
-  executor.add_node(sink);
+  // The relays are created on --create-threads threads.
+  std::cout << "Creating " << num_nodes + 2 << " nodes ... " << std::flush;
+  auto source = std::make_shared<PnodeSource>(rclcpp::NodeOptions(), config);
+  std::vector<std::shared_ptr<PnodeRelay>> relays(num_nodes);
+  benchcore::parallel_for(flags, num_nodes, [&](int n) {
+    rclcpp::NodeOptions node_options;
+    std::vector<std::string> arguments = {std::to_string(n % config.num_relays)};
+    if (config.width > 1) {
+      arguments.push_back(std::to_string(n / config.num_relays));
+    }
+    node_options.arguments(arguments);
+    relays[n] = std::make_shared<PnodeRelay>(node_options, config);
+  });
+  auto sink = std::make_shared<PnodeSink>(rclcpp::NodeOptions(), config);
+  // Discovery is done once every relay has matched both its publisher and
+  // its subscription, and the sink has matched the last relays. The thread
+  // holds its own references to the nodes, since the sink may exit() while
+  // it waits, and gives up after kDiscoveryTimeout or once main is done.
+  std::atomic<bool> stop_discovery{false};
+  std::thread discovery;
+  if (startup) {
+    startup->mark("create");
+    discovery = std::thread([relays, sink, report = startup.get(), &stop_discovery]() {
+      auto deadline = std::chrono::steady_clock::now() + kDiscoveryTimeout;
+      auto wait_for = [&](auto matched) {
+        while (!matched()) {
+          if (stop_discovery || std::chrono::steady_clock::now() > deadline) {
+            return false;
+          }
+          std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return true;
+      };
+      for (const auto& relay : relays) {
+        if (!wait_for([&relay]() { return relay->matched(); })) {
+          report->mark("discovery timed out");
+          return;
+        }
+      }
+      if (!wait_for([&sink]() { return sink->matched(); })) {
+        report->mark("discovery timed out");
+        return;
+      }
+      report->mark("discovery");
+    });
+  }
+
+  // Use a multi-threaded executor to spin all nodes, unless another one is
+  // selected with --executor. When tracing, use an executor equivalent to the
+  // multi-threaded one that also records when it picks up each callback.
+  // With --partitions=K, there are K of them, each spinning its share of the
+  // nodes on threads of its own, see partition.hpp.
+  Partitioning partitioning(flags, num_nodes + 2);
+  if (trace && partitioning.partitions() > 1) {
+    throw std::invalid_argument("--trace-hops doesn't work with --partitions");
+  }
+  std::vector<std::unique_ptr<rclcpp::Executor>> executors;
+  for (int i = 0; i < partitioning.partitions(); ++i) {
+    if (trace) {
+      executors.push_back(std::make_unique<TracedExecutor>());
+    } else {
+      executors.push_back(pexec::make_executor(flags));
+    }
+  }
+  // Every executor's nodes, in chain order.
+  std::vector<std::vector<rclcpp::Node::SharedPtr>> executor_nodes(executors.size());
+  executor_nodes[partitioning.of(0)].push_back(source);
+  for (int n = 0; n < num_nodes; ++n) {
+    executor_nodes[partitioning.of(n + 1)].push_back(relays[n]);
+  }
+  executor_nodes[partitioning.of(num_nodes + 1)].push_back(sink);
+  for (size_t i = 0; i < executors.size(); ++i) {
+    for (const rclcpp::Node::SharedPtr& node : executor_nodes[i]) {
+      executors[i]->add_node(node);
+    }
+  }
+  // With --exec-affinity=block|round-robin|0,1,..., a lowlatency executor
+  // queues every node's callbacks to a fixed worker, mapping its nodes in
+  // chain order to the workers like --partition-map does to executors.
+  if (flags.has("exec-affinity")) {
+    if (pexec::executor_name(flags) != "lowlatency") {
+      throw std::invalid_argument("--exec-affinity needs --executor=lowlatency");
+    }
+    for (size_t i = 0; i < executors.size(); ++i) {
+      auto& executor = static_cast<pexec::LowLatencyExecutor&>(*executors[i]);
+      Partitioning workers(executor.number_of_threads(), flags.get("exec-affinity"),
+                           executor_nodes[i].size());
+      for (size_t n = 0; n < executor_nodes[i].size(); ++n) {
+        executor.set_node_affinity(executor_nodes[i][n]->get_node_base_interface(),
+                                   workers.of(n));
+      }
+    }
+  }
+
+  // An isolated bulk chain's callback groups are spun by a single-threaded
+  // executor on its own thread, so its callbacks never hold up the measured
+  // chain's executor threads.
+  rclcpp::executors::SingleThreadedExecutor bulk_executor;
+  std::thread bulk_thread;
+  if (config.bulk.enabled() && config.bulk.isolated) {
+    for (auto& relay : relays) {
+      if (relay->bulk_group()) {
+        bulk_executor.add_callback_group(relay->bulk_group(), relay->get_node_base_interface());
+      }
+    }
+    bulk_executor.add_callback_group(sink->bulk_group(), sink->get_node_base_interface());
+    bulk_thread = std::thread([&bulk_executor]() { bulk_executor.spin(); });
+  }
+  std::unique_ptr<benchcore::BulkSource> bulk_source;
+  if (config.bulk.enabled()) {
+    bulk_source = std::make_unique<benchcore::BulkSource>(
+        config.bulk, [&source](int64_t msgid, const std::string& payload) {
+          source->publish_bulk(msgid, payload);
+        });
+  }
+
   std::cout << "\nAll nodes ready. Start spinning...\n";
-  executor.spin();
+  benchcore::IdleAnalysis idle_analysis(flags);
+  std::vector<std::thread> executor_threads;
+  for (size_t i = 1; i < executors.size(); ++i) {
+    executor_threads.emplace_back([&executors, i]() { executors[i]->spin(); });
+  }
+  executors[0]->spin();
+  for (size_t i = 1; i < executors.size(); ++i) {
+    executors[i]->cancel();
+    executor_threads[i - 1].join();
+  }
+  bulk_source.reset();
+  if (bulk_thread.joinable()) {
+    bulk_executor.cancel();
+    bulk_thread.join();
+  }
+  stop_discovery = true;
+  if (discovery.joinable()) {
+    discovery.join();
+  }
 
   rclcpp::shutdown();
   return 0;
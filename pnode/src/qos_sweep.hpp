@@ -0,0 +1,86 @@
+#pragma once
+
+#include <chrono>
+#include <iostream>
+#include <regex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "benchcore/flags.hpp"
+#include "benchcore/sweep.hpp"
+
+// Runs pnode once per QoS combination and prints latency, drops, missed
+// deadlines and peak RSS of each as a table. Every combination runs in a
+// fresh process, so memory held by one doesn't show up in the next.
+//
+// Unless given, the runs publish --messages=2000 of --payload-size=10000 at
+// --rate-hz=2000 to load the chain. Combinations are all reliabilities and
+// durabilities, --sweep-depths (default 1,10,100,1000), and no deadline or
+// lifespan, a --sweep-deadline-ms deadline or a --sweep-lifespan-ms lifespan
+// (default 10 each), each on --sweep-widths parallel chains (default 1,4), so
+// drops are counted per chain too. Other flags are passed on to every run.
+inline int run_qos_sweep(const benchcore::Flags& flags) {
+  int64_t messages = flags.get_int("messages", 2000);
+  int64_t payload_size = flags.get_int("payload-size", 10000);
+  std::string rate_hz = flags.get("rate-hz", "2000");
+  std::vector<std::string> load = {"--messages=" + std::to_string(messages),
+                                   "--payload-size=" + std::to_string(payload_size),
+                                   "--rate-hz=" + rate_hz};
+
+  std::vector<std::string> widths = benchcore::split(flags.get("sweep-widths", "1,4"));
+  std::vector<std::string> depths = benchcore::split(flags.get("sweep-depths", "1,10,100,1000"));
+  std::string deadline_ms = flags.get("sweep-deadline-ms", "10");
+  std::string lifespan_ms = flags.get("sweep-lifespan-ms", "10");
+  std::vector<std::pair<std::string, std::string>> timings = {
+      {"none", ""},
+      {"deadline " + deadline_ms + "ms", "--deadline-ms=" + deadline_ms},
+      {"lifespan " + lifespan_ms + "ms", "--lifespan-ms=" + lifespan_ms},
+  };
+
+  std::vector<benchcore::SweepCase> cases;
+  std::vector<std::vector<std::string>> rows;
+  for (const std::string& width : widths) {
+    for (std::string reliability : {"reliable", "best_effort"}) {
+      for (std::string durability : {"volatile", "transient_local"}) {
+        for (const std::string& depth : depths) {
+          for (const auto& [timing_name, timing_flag] : timings) {
+            benchcore::SweepCase sweep_case{width + " wide, " + reliability + ", " + durability +
+                                                ", depth " + depth + ", " + timing_name,
+                                            load};
+            sweep_case.args.insert(sweep_case.args.end(),
+                                   {"--width=" + width, "--reliability=" + reliability,
+                                    "--durability=" + durability, "--depth=" + depth});
+            if (!timing_flag.empty()) {
+              sweep_case.args.push_back(timing_flag);
+            }
+            cases.push_back(std::move(sweep_case));
+            rows.push_back({width, reliability, durability, depth, timing_name});
+          }
+        }
+      }
+    }
+  }
+  std::vector<benchcore::SweepRun> runs =
+      benchcore::run_sweep(flags, {"--qos-sweep"}, cases, std::chrono::seconds(120));
+
+  static const std::regex dropped_re("messages, ([\\d.]+) dropped");
+  static const std::regex deadline_re("Deadline missed: (\\d+)");
+  static const std::regex memory_re("peak RSS (\\d+) MB");
+  for (size_t i = 0; i < runs.size(); ++i) {
+    const benchcore::SweepRun& run = runs[i];
+    rows[i].insert(rows[i].end(),
+                   {run.stats.p50_cell(), run.stats.p90_cell(),
+                    benchcore::find_in_output(run.process, dropped_re),
+                    benchcore::find_in_output(run.process, deadline_re),
+                    benchcore::find_in_output(run.process, memory_re)});
+  }
+  benchcore::print_sweep_table(
+      std::cout,
+      "QoS sweep, " + std::to_string(messages) + " messages of " + std::to_string(payload_size) +
+          " bytes at " + rate_hz + "Hz:",
+      {"Width", "Reliability", "Durability", "Depth", "Deadline/Lifespan", "P50 (us/hop)",
+       "P90 (us/hop)", "Dropped", "Deadline missed", "Peak RSS (MB)"},
+      rows);
+  return 0;
+}
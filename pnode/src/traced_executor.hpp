@@ -0,0 +1,82 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "hop_trace.hpp"
+#include "rclcpp/rclcpp.hpp"
+#include "rcpputils/scope_exit.hpp"
+
+// A multi-threaded executor that records when each executable was taken out
+// of the wait set. It follows the same scheduling as
+// rclcpp::executors::MultiThreadedExecutor: one thread at a time waits on the
+// wait set and takes the next ready executable under a mutex, then executes
+// it outside the mutex. The callbacks read the pick time of the executable
+// they run in through picked_time(), on the same thread.
+class TracedExecutor : public rclcpp::Executor {
+ public:
+  explicit TracedExecutor(size_t number_of_threads = 0)
+      : number_of_threads_(number_of_threads > 0
+                               ? number_of_threads
+                               : std::max(std::thread::hardware_concurrency(), 2U)) {}
+
+  void spin() override {
+    if (spinning.exchange(true)) {
+      throw std::runtime_error("spin() called while already spinning");
+    }
+    RCPPUTILS_SCOPE_EXIT(this->spinning.store(false););
+    std::vector<std::thread> threads;
+    {
+      std::lock_guard<std::mutex> wait_lock(wait_mutex_);
+      for (size_t i = 0; i + 1 < number_of_threads_; ++i) {
+        threads.emplace_back([this]() { run(); });
+      }
+    }
+    run();
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  }
+
+  // The time the current thread took the executable it is running.
+  static int64_t picked_time() { return picked_time_; }
+
+ private:
+  void run() {
+    while (rclcpp::ok(this->context_) && spinning.load()) {
+      rclcpp::AnyExecutable any_exec;
+      {
+        std::lock_guard<std::mutex> wait_lock(wait_mutex_);
+        if (!rclcpp::ok(this->context_) || !spinning.load()) {
+          return;
+        }
+        if (!get_next_ready_executable(any_exec)) {
+          wait_for_work(std::chrono::nanoseconds(-1));
+          if (!get_next_ready_executable(any_exec)) {
+            continue;
+          }
+        }
+        picked_time_ = trace_now();
+      }
+      execute_any_executable(any_exec);
+
+      // Same as MultiThreadedExecutor: wake the waiting thread, so it picks up
+      // work of the mutually exclusive group that just became available again.
+      if (any_exec.callback_group &&
+          any_exec.callback_group->type() == rclcpp::CallbackGroupType::MutuallyExclusive) {
+        interrupt_guard_condition_->trigger();
+      }
+      // Clear the callback_group to prevent the AnyExecutable destructor from
+      // resetting the callback group `can_be_taken_from`.
+      any_exec.callback_group.reset();
+    }
+  }
+
+  size_t number_of_threads_;
+  std::mutex wait_mutex_;
+  static inline thread_local int64_t picked_time_ = 0;
+};
@@ -1,10 +1,25 @@
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <iostream>
+#include <limits>
 #include <memory>
-#include <set>
+#include <mutex>
+#include <stdexcept>
 #include <thread>
+#include <utility>
 #include <vector>
 
+#include "benchcore/chain.hpp"
+#include "benchcore/clock.hpp"
+#include "benchcore/flags.hpp"
+#include "benchcore/idle.hpp"
+#include "benchcore/memory.hpp"
+#include "benchcore/report.hpp"
+#include "benchcore/soak.hpp"
+#include "benchcore/traffic.hpp"
+#include "benchcore/warmup.hpp"
+#include "pexec/executors.hpp"
 #include "pnodeif/srv/bench.hpp"
 #include "rclcpp/rclcpp.hpp"
 
@@ -14,31 +29,139 @@ using ClientNode =
 using ServiceNode =
     std::pair<std::shared_ptr<rclcpp::Node>, std::shared_ptr<rclcpp::Service<pnodeif::srv::Bench>>>;
 
-constexpr int kNumRelays = 20;
+using benchcore::kNumRelays;
+constexpr int kNumMessages = benchcore::kNumSamples;
 
-// The client thread to initiate the service requests.
-void client_thread(std::shared_ptr<rclcpp::Client<pnodeif::srv::Bench>> client) {
+int64_t now_ns() { return benchcore::now_ns(); }
+
+// Requests a hop has sent downstream without having received the response
+// yet. Only tracked with --chain-responses, where responses are processed.
+struct PendingRequests {
+  std::atomic<int64_t> current{0};
+  std::atomic<int64_t> max{0};
+  std::atomic<int64_t> sum{0};
+  std::atomic<int64_t> sends{0};
+
+  void on_send() {
+    int64_t pending = ++current;
+    sum += pending;
+    ++sends;
+    int64_t prev_max = max.load();
+    while (pending > prev_max && !max.compare_exchange_weak(prev_max, pending));
+  }
+  void on_response() { --current; }
+};
+
+// Round trip times seen by the client with --chain-responses. Every relay
+// only responds after the next hop responded, so the client's response
+// arrives after the request went through the whole chain and back. With
+// --warmup, the first round trips are dropped like the sink's messages.
+class RoundTrips {
+ public:
+  RoundTrips(std::vector<PendingRequests>& pending, int num_messages,
+             std::unique_ptr<benchcore::Warmup> warmup)
+      : pending_(pending), send_ns_(num_messages), warmup_(std::move(warmup)) {}
+
+  void on_send(int64_t msgid) { send_ns_[msgid].store(now_ns()); }
+
+  void on_response(int64_t msgid) {
+    int64_t rtt = now_ns() - send_ns_[msgid].load();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (warmup_ && warmup_->add(rtt / (2 * (kNumRelays + 1)))) {
+      return;
+    }
+    data_.push_back(rtt);
+    if (data_.size() >= kNumMessages) {
+      print_stats();
+      benchcore::print_report_sections(std::cout);
+      exit(0);
+    }
+  }
+
+ private:
+  void print_stats() {
+    std::sort(data_.begin(), data_.end());
+    int64_t p50 = data_[data_.size() / 2];
+    int64_t p90 = data_[data_.size() * 9 / 10];
+    std::cout << "Round trip stats with " << data_.size() << " data points:"
+              << "\nP50 = " << p50 / 1000 << "us, P90 = " << p90 / 1000 << "us"
+              << "\nPer hop and direction: P50 = " << p50 / (2 * (kNumRelays + 1)) / 1000
+              << "us, P90 = " << p90 / (2 * (kNumRelays + 1)) / 1000 << "us\n\n";
+    std::cout << "Outstanding requests per hop, avg/max:\n";
+    for (size_t hop = 0; hop < pending_.size(); ++hop) {
+      const PendingRequests& p = pending_[hop];
+      double avg = p.sends > 0 ? static_cast<double>(p.sum) / p.sends : 0;
+      std::cout << "  hop " << hop << ": " << avg << "/" << p.max << "\n";
+    }
+    std::cout << "\n";
+  }
+
+  std::vector<PendingRequests>& pending_;
+  std::vector<std::atomic<int64_t>> send_ns_;
+  std::unique_ptr<benchcore::Warmup> warmup_;
+  std::mutex mutex_;
+  std::vector<int64_t> data_;
+};
+
+// The client thread to initiate num_messages service requests, paced by
+// --traffic. With round_trips set, responses are timed, otherwise they are ignored.
+void client_thread(std::shared_ptr<rclcpp::Client<pnodeif::srv::Bench>> client,
+                   RoundTrips* round_trips, PendingRequests* pending, benchcore::Pacer* pacer,
+                   int num_messages) {
   std::cout << "Wating for relay ...";
   while (!client->wait_for_service(1s));
   std::cout << " ready.\n";
 
-  for (int i = 0; i < 1000; i++) {
+  for (int i = 0; i < num_messages; i++) {
     auto request = std::make_shared<pnodeif::srv::Bench::Request>();
     request->timing.source = "client";
     request->timing.msgid = i;
-    request->timing.nanosec = std::chrono::duration_cast<std::chrono::nanoseconds>(
-                                  std::chrono::steady_clock::now().time_since_epoch())
-                                  .count();
-    auto result = client->async_send_request(
-        request, [](std::shared_future<std::shared_ptr<pnodeif::srv::Bench::Response>>) {});
-    std::this_thread::sleep_for(1ms);
+    request->timing.nanosec = now_ns();
+    if (round_trips) {
+      round_trips->on_send(i);
+      pending->on_send();
+      client->async_send_request(
+          request,
+          [round_trips, pending](
+              std::shared_future<std::shared_ptr<pnodeif::srv::Bench::Response>> future) {
+            pending->on_response();
+            round_trips->on_response(future.get()->ack);
+          });
+    } else {
+      auto result = client->async_send_request(
+          request, [](std::shared_future<std::shared_ptr<pnodeif::srv::Bench::Response>>) {});
+    }
+    pacer->wait();
   }
   std::cout << "All requests sent.\n";
 }
 
 int main(int argc, char* argv[]) {
   rclcpp::init(argc, argv);
-  rclcpp::executors::MultiThreadedExecutor executor;
+  benchcore::Flags flags(rclcpp::remove_ros_arguments(argc, argv));
+  // With --executor-sweep, run this binary once per executor.
+  if (flags.has("executor-sweep")) {
+    int status = pexec::run_executor_sweep(flags);
+    rclcpp::shutdown();
+    return status;
+  }
+  benchcore::init_clock(flags);
+  // A multi-threaded executor unless another one is selected with --executor.
+  std::unique_ptr<rclcpp::Executor> executor = pexec::make_executor(flags);
+  // With --chain-responses, relays defer their response until the next hop
+  // responded, and the client measures the round trip.
+  bool chain_responses = flags.get_bool("chain-responses");
+  std::vector<PendingRequests> pending(kNumRelays + 1);
+  // With --soak-minutes, the client keeps sending and the sink feeds the
+  // monitor, which ends the run. See benchcore/soak.hpp.
+  bool soak = benchcore::soak_requested(flags);
+  if (soak && chain_responses) {
+    throw std::invalid_argument("--soak-minutes measures at the sink, not with --chain-responses");
+  }
+
+  // With --memmon, sample memory from before the nodes are created. Every
+  // hop has a client node and a service node, the payload is "client".
+  auto memory = benchcore::MemorySampler::from_flags(flags, 2 * (kNumRelays + 1), 6);
 
   // Create the clients.
   std::vector<ClientNode> clients;
@@ -46,6 +169,10 @@ int main(int argc, char* argv[]) {
     auto node = rclcpp::Node::make_shared("srv_client_" + std::to_string(i));
     auto client = node->create_client<pnodeif::srv::Bench>("srv_relay_" + std::to_string(i));
     clients.emplace_back(std::move(node), std::move(client));
+    // The clients only need spinning to process the responses.
+    if (chain_responses) {
+      executor->add_node(clients[i].first);
+    }
   }
 
   // Create the relay services.
@@ -55,56 +182,87 @@ int main(int argc, char* argv[]) {
   for (int i = 0; i < kNumRelays; i++) {
     auto node = rclcpp::Node::make_shared("srv_relay_" + std::to_string(i));
     auto client = clients[i + 1].second;
-    auto service = node->create_service<pnodeif::srv::Bench>(
-        "srv_relay_" + std::to_string(i),
-        [i, client = std::move(client)](const std::shared_ptr<pnodeif::srv::Bench::Request> request,
-                                        std::shared_ptr<pnodeif::srv::Bench::Response> response) {
-          response->ack = request->timing.msgid;
-          // std::cout << "relay[" << i << "] " << request->timing.msgid << "\n ";
-          auto copy = std::make_shared<pnodeif::srv::Bench::Request>();
-          copy->timing.source = "srv relay " + std::to_string(i);
-          copy->timing.msgid = request->timing.msgid;
-          copy->timing.nanosec = request->timing.nanosec;
-          client->async_send_request(
-              copy, [](std::shared_future<std::shared_ptr<pnodeif::srv::Bench::Response>>) {});
-        });
+    std::shared_ptr<rclcpp::Service<pnodeif::srv::Bench>> service;
+    if (chain_responses) {
+      // Deferred response: the callback returns without a response, and the
+      // response is sent from the callback of the downstream request.
+      PendingRequests* hop_pending = &pending[i + 1];
+      service = node->create_service<pnodeif::srv::Bench>(
+          "srv_relay_" + std::to_string(i),
+          [i, client = std::move(client), hop_pending](
+              std::shared_ptr<rclcpp::Service<pnodeif::srv::Bench>> service,
+              std::shared_ptr<rmw_request_id_t> header,
+              std::shared_ptr<pnodeif::srv::Bench::Request> request) {
+            auto copy = std::make_shared<pnodeif::srv::Bench::Request>();
+            copy->timing.source = "srv relay " + std::to_string(i);
+            copy->timing.msgid = request->timing.msgid;
+            copy->timing.nanosec = request->timing.nanosec;
+            hop_pending->on_send();
+            client->async_send_request(
+                copy,
+                [service, header, hop_pending](
+                    std::shared_future<std::shared_ptr<pnodeif::srv::Bench::Response>> future) {
+                  hop_pending->on_response();
+                  pnodeif::srv::Bench::Response response;
+                  response.ack = future.get()->ack;
+                  service->send_response(*header, response);
+                });
+          });
+    } else {
+      service = node->create_service<pnodeif::srv::Bench>(
+          "srv_relay_" + std::to_string(i),
+          [i, client = std::move(client)](
+              const std::shared_ptr<pnodeif::srv::Bench::Request> request,
+              std::shared_ptr<pnodeif::srv::Bench::Response> response) {
+            response->ack = request->timing.msgid;
+            // std::cout << "relay[" << i << "] " << request->timing.msgid << "\n ";
+            auto copy = std::make_shared<pnodeif::srv::Bench::Request>();
+            copy->timing.source = "srv relay " + std::to_string(i);
+            copy->timing.msgid = request->timing.msgid;
+            copy->timing.nanosec = request->timing.nanosec;
+            client->async_send_request(
+                copy, [](std::shared_future<std::shared_ptr<pnodeif::srv::Bench::Response>>) {});
+          });
+    }
     services.emplace_back(std::move(node), std::move(service));
-    executor.add_node(services[i].first);
+    executor->add_node(services[i].first);
   }
 
   // Create the sink service.
-  // The sink service gets requests from the last relay service, and computes
-  // the per-hop communication latency.
-  std::unordered_multiset<int64_t> data;
+  // The sink service gets requests from the last relay service, and passes
+  // them to the recorder, which computes the per-hop communication latency.
+  // With --traffic, the client sends one request per 1ms on average. With
+  // chained responses, the last responses are still on their way back when
+  // the sink has its samples. The client then prints the rest of the stats
+  // and exits.
+  benchcore::RecorderOptions recorder_options;
+  recorder_options.period = 1ms;
+  recorder_options.exit = !chain_responses;
+  benchcore::LatencyRecorder recorder(flags, std::move(recorder_options));
+  int num_messages = kNumMessages + benchcore::Warmup::extra_messages(flags);
   auto sink_node = rclcpp::Node::make_shared("srv_sink");
   auto sink_service = sink_node->create_service<pnodeif::srv::Bench>(
       "srv_relay_" + std::to_string(kNumRelays),
-      [&data](const std::shared_ptr<pnodeif::srv::Bench::Request> request,
-              std::shared_ptr<pnodeif::srv::Bench::Response> response) {
+      [&recorder](const std::shared_ptr<pnodeif::srv::Bench::Request> request,
+                  std::shared_ptr<pnodeif::srv::Bench::Response> response) {
         response->ack = request->timing.msgid;
-        int64_t nanosec = std::chrono::duration_cast<std::chrono::nanoseconds>(
-                              std::chrono::steady_clock::now().time_since_epoch())
-                              .count();
-        int64_t nanosec_per_hop = (nanosec - request->timing.nanosec) / (kNumRelays + 1);
-        data.insert(nanosec_per_hop);
-        std::cout << "nano seconds per hop: " << nanosec_per_hop << "\n";
-        if (data.size() >= 1000) {
-          std::vector<int64_t> array(data.cbegin(), data.cend());
-          std::sort(array.begin(), array.end());
-          int p50_index = array.size() / 2;
-          int p90_index = array.size() * 9 / 10;
-          std::cout << "\nStats with " << array.size() << " data points, ns/hop:"
-                    << "\nP50 = " << array[p50_index] / 1000
-                    << "us, P90 = " << array[p90_index] / 1000 << "us\n\n";
-          exit(0);
-        }
+        int64_t nanosec = recorder.arrived(1);
+        recorder.record(request->timing.msgid, request->timing.nanosec, nanosec);
       });
-  executor.add_node(sink_node);
+  executor->add_node(sink_node);
 
   // Create the client thread.
-  std::thread client(client_thread, clients[0].second);
+  benchcore::IdleAnalysis idle_analysis(flags);
+  std::unique_ptr<RoundTrips> round_trips;
+  if (chain_responses) {
+    round_trips = std::make_unique<RoundTrips>(pending, num_messages,
+                                               benchcore::Warmup::from_flags(flags, "round trips"));
+  }
+  benchcore::Pacer pacer(flags, 1ms);
+  std::thread client(client_thread, clients[0].second, round_trips.get(), &pending[0], &pacer,
+                     soak ? std::numeric_limits<int>::max() : num_messages);
   // Spin the executor.
-  executor.spin();
+  executor->spin();
   rclcpp::shutdown();
   return 0;
 }
\ No newline at end of file
@@ -0,0 +1,168 @@
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ament_index_cpp/get_package_prefix.hpp"
+#include "benchcore/flags.hpp"
+#include "benchcore/process.hpp"
+#include "benchcore/sweep.hpp"
+
+// One way to run a benchmark under an RMW implementation.
+struct RmwConfig {
+  std::string rmw;
+  // Whether the RMW's shared memory transport is enabled.
+  bool shm;
+  benchcore::Environment env;
+  // A daemon the RMW needs, started before the runs and stopped after.
+  std::vector<std::string> daemon;
+};
+
+std::optional<std::string> package_prefix(const std::string& package) {
+  try {
+    return ament_index_cpp::get_package_prefix(package);
+  } catch (const ament_index_cpp::PackageNotFoundError&) {
+    return std::nullopt;
+  }
+}
+
+bool is_executable(const std::string& path) { return access(path.c_str(), X_OK) == 0; }
+
+std::string cyclonedds_uri(bool shm) {
+  return std::string("<CycloneDDS><Domain><SharedMemory><Enable>") + (shm ? "true" : "false") +
+         "</Enable></SharedMemory></Domain></CycloneDDS>";
+}
+
+// The shared memory on and off configurations of an installed RMW, or none
+// if it's not installed.
+//  * Fast DDS: builtin transports UDPv4 only, or the default UDPv4 + SHM.
+//  * Cyclone DDS: iceoryx shared memory, with iox-roudi running.
+//  * zenoh: the session's shared memory transport, with rmw_zenohd running.
+std::vector<RmwConfig> rmw_configs(const std::string& rmw) {
+  if (!package_prefix(rmw)) {
+    return {};
+  }
+  std::vector<RmwConfig> configs;
+  for (bool shm : {false, true}) {
+    RmwConfig config{rmw, shm, {{"RMW_IMPLEMENTATION", rmw}}, {}};
+    if (rmw == "rmw_fastrtps_cpp") {
+      config.env.emplace_back("FASTDDS_BUILTIN_TRANSPORTS", shm ? "DEFAULT" : "UDPv4");
+    } else if (rmw == "rmw_cyclonedds_cpp") {
+      config.env.emplace_back("CYCLONEDDS_URI", cyclonedds_uri(shm));
+      if (shm) {
+        auto iceoryx = package_prefix("iceoryx_posh");
+        if (!iceoryx || !is_executable(*iceoryx + "/bin/iox-roudi")) {
+          std::cout << "iox-roudi not found, skipping " << rmw << " with shared memory.\n";
+          continue;
+        }
+        config.daemon = {*iceoryx + "/bin/iox-roudi"};
+      }
+    } else if (rmw == "rmw_zenoh_cpp") {
+      config.env.emplace_back("ZENOH_CONFIG_OVERRIDE",
+                              std::string("transport/shared_memory/enabled=") +
+                                  (shm ? "true" : "false"));
+      config.daemon = {*package_prefix(rmw) + "/lib/rmw_zenoh_cpp/rmw_zenohd"};
+    }
+    configs.push_back(std::move(config));
+  }
+  return configs;
+}
+
+// Median of the runs that produced stats, or the first error. There's at
+// least one run.
+benchcore::LatencyStats median(std::vector<benchcore::LatencyStats> results) {
+  std::vector<benchcore::LatencyStats> ok;
+  for (const benchcore::LatencyStats& r : results) {
+    if (r.ok()) {
+      ok.push_back(r);
+    }
+  }
+  if (ok.empty()) {
+    return results.front();
+  }
+  auto mid = ok.begin() + ok.size() / 2;
+  std::nth_element(ok.begin(), mid, ok.end(),
+                   [](const auto& a, const auto& b) { return a.p50_us < b.p50_us; });
+  int64_t p50 = mid->p50_us;
+  std::nth_element(ok.begin(), mid, ok.end(),
+                   [](const auto& a, const auto& b) { return a.p90_us < b.p90_us; });
+  return benchcore::LatencyStats{"", p50, mid->p90_us};
+}
+
+// Runs pnode and psrv under every installed RMW, with its shared memory
+// transport off and on, and prints one table per RMW.
+//   --rmw=rmw_fastrtps_cpp,...  RMWs to try, default all supported.
+//   --benchmarks=pnode,psrv     benchmarks to run.
+//   --runs=N                    runs per cell, at least 1, the median is reported.
+//   --timeout=S                 seconds before a run is stopped.
+// Arguments after "--" are passed to the benchmarks, e.g.
+// "rmwmatrix -- --executor=single".
+int main(int argc, char* argv[]) {
+  benchcore::Flags flags(argc, argv);
+  std::vector<std::string> rmws =
+      benchcore::split(flags.get("rmw", "rmw_fastrtps_cpp,rmw_cyclonedds_cpp,rmw_zenoh_cpp"));
+  std::vector<std::string> benchmarks = benchcore::split(flags.get("benchmarks", "pnode,psrv"));
+  int runs = flags.get_int("runs", 1);
+  if (runs < 1) {
+    throw std::invalid_argument("--runs must be at least 1");
+  }
+  std::chrono::seconds timeout(flags.get_int("timeout", 120));
+  std::vector<std::string> bench_args;
+  auto separator = std::find(flags.args().begin(), flags.args().end(), "--");
+  if (separator != flags.args().end()) {
+    bench_args.assign(separator + 1, flags.args().end());
+  }
+
+  // Per RMW, a row per benchmark and shared memory setting.
+  std::map<std::string, std::vector<std::vector<std::string>>> tables;
+  for (const std::string& rmw : rmws) {
+    std::vector<RmwConfig> configs = rmw_configs(rmw);
+    if (configs.empty()) {
+      std::cout << rmw << " is not installed, skipping.\n";
+      continue;
+    }
+    for (const RmwConfig& config : configs) {
+      pid_t daemon = config.daemon.empty() ? 0 : benchcore::start_process(config.daemon);
+      if (daemon) {
+        // Give the daemon time to come up before the first participant.
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+      }
+      for (const std::string& benchmark : benchmarks) {
+        auto prefix = package_prefix(benchmark);
+        if (!prefix) {
+          std::cout << benchmark << " is not installed, skipping.\n";
+          continue;
+        }
+        std::vector<std::string> argv = {*prefix + "/lib/" + benchmark + "/" + benchmark};
+        argv.insert(argv.end(), bench_args.begin(), bench_args.end());
+        std::vector<benchcore::LatencyStats> results;
+        for (int i = 0; i < runs; ++i) {
+          std::cout << "Running " << benchmark << " on " << rmw << ", shared memory "
+                    << (config.shm ? "on" : "off") << ", run " << i + 1 << "/" << runs << "\n"
+                    << std::flush;
+          results.push_back(
+              benchcore::parse_latency_stats(benchcore::run_process(argv, config.env, timeout)));
+        }
+        benchcore::LatencyStats stats = median(std::move(results));
+        tables[rmw].push_back(
+            {benchmark, config.shm ? "on" : "off", stats.p50_cell(), stats.p90_cell()});
+      }
+      if (daemon) {
+        benchcore::stop_process(daemon);
+      }
+    }
+  }
+
+  for (const auto& [rmw, rows] : tables) {
+    benchcore::print_sweep_table(std::cout, rmw,
+                                 {"Benchmark", "SHM", "P50 (us/hop)", "P90 (us/hop)"}, rows);
+  }
+  return 0;
+}
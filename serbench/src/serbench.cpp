@@ -0,0 +1,249 @@
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gen-cpp/timing_types.h"
+#include "pnodeif/msg/timing.hpp"
+#include "rclcpp/serialization.hpp"
+#include "rclcpp/serialized_message.hpp"
+#include "timing.pb.h"
+
+using namespace std::chrono_literals;
+
+// Same message sizes as the zenoh multi-process table in the README.
+const std::vector<size_t> kPayloadSizes = {10, 1000, 10000, 100000, 1000000};
+// Each case runs for at least this long, after warmup.
+constexpr auto kMinRunTime = 200ms;
+constexpr int kWarmupIterations = 100;
+
+// Count every heap allocation, including the ones made from C code such as
+// the rmw CDR serializer, by interposing the glibc allocator entry points.
+std::atomic<int64_t> g_allocations{0};
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void __libc_free(void* ptr);
+
+void* malloc(size_t size) {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_malloc(size);
+}
+void* calloc(size_t count, size_t size) {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_calloc(count, size);
+}
+void* realloc(void* ptr, size_t size) {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_realloc(ptr, size);
+}
+void free(void* ptr) { __libc_free(ptr); }
+}
+
+// The cost of one serialization or deserialization operation.
+struct OpCost {
+  double ns = 0;
+  double allocs = 0;
+};
+
+// Runs fn repeatedly until kMinRunTime has elapsed, and returns the average
+// cost per call. fn returns a size so the work can't be optimized away.
+template <typename Fn>
+OpCost measure(Fn&& fn) {
+  static volatile size_t sink = 0;
+  for (int i = 0; i < kWarmupIterations; ++i) {
+    sink = sink + fn();
+  }
+
+  int64_t iterations = 16;
+  while (true) {
+    int64_t allocs_before = g_allocations.load(std::memory_order_relaxed);
+    auto start = std::chrono::steady_clock::now();
+    for (int64_t i = 0; i < iterations; ++i) {
+      sink = sink + fn();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    int64_t allocs = g_allocations.load(std::memory_order_relaxed) - allocs_before;
+    if (elapsed >= kMinRunTime) {
+      OpCost cost;
+      cost.ns = std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+      cost.allocs = static_cast<double>(allocs) / iterations;
+      return cost;
+    }
+    iterations *= 2;
+  }
+}
+
+// One row of the result table.
+struct Row {
+  std::string format;
+  bool reuse;
+  size_t payload;
+  size_t bytes;
+  OpCost ser;
+  OpCost de;
+};
+
+void print_header() {
+  std::cout << std::left << std::setw(16) << "format" << std::setw(8) << "buffer" << std::right
+            << std::setw(10) << "payload" << std::setw(10) << "bytes" << std::setw(12) << "ser ns/op"
+            << std::setw(12) << "ser allocs" << std::setw(12) << "de ns/op" << std::setw(12)
+            << "de allocs"
+            << "\n";
+}
+
+void print_row(const Row& row) {
+  std::cout << std::left << std::setw(16) << row.format << std::setw(8)
+            << (row.reuse ? "reuse" : "fresh") << std::right << std::setw(10) << row.payload
+            << std::setw(10) << row.bytes << std::fixed << std::setprecision(1) << std::setw(12)
+            << row.ser.ns << std::setw(12) << row.ser.allocs << std::setw(12) << row.de.ns
+            << std::setw(12) << row.de.allocs << "\n";
+}
+
+// ROS 2 CDR, through the same rmw serializer the publishers use.
+Row bench_cdr(const std::string& payload, bool reuse) {
+  pnodeif::msg::Timing msg;
+  msg.msgid = 1;
+  msg.nanosec = 1;
+  msg.source = payload;
+
+  rclcpp::Serialization<pnodeif::msg::Timing> serialization;
+  rclcpp::SerializedMessage buffer;
+  serialization.serialize_message(&msg, &buffer);
+
+  Row row{"cdr", reuse, payload.size(), buffer.size(), {}, {}};
+  row.ser = measure([&]() {
+    if (reuse) {
+      serialization.serialize_message(&msg, &buffer);
+      return buffer.size();
+    }
+    rclcpp::SerializedMessage fresh;
+    serialization.serialize_message(&msg, &fresh);
+    return fresh.size();
+  });
+
+  pnodeif::msg::Timing out;
+  row.de = measure([&]() {
+    if (reuse) {
+      serialization.deserialize_message(&buffer, &out);
+      return out.source.size();
+    }
+    pnodeif::msg::Timing fresh;
+    serialization.deserialize_message(&buffer, &fresh);
+    return fresh.source.size();
+  });
+  return row;
+}
+
+// protobuf wire format, as sent by the gRPC benchmark.
+Row bench_protobuf(const std::string& payload, bool reuse) {
+  timing::Request msg;
+  msg.set_msgid(1);
+  msg.set_nanosec(1);
+  msg.set_source(payload);
+
+  std::string buffer;
+  msg.SerializeToString(&buffer);
+
+  Row row{"protobuf", reuse, payload.size(), buffer.size(), {}, {}};
+  row.ser = measure([&]() {
+    if (reuse) {
+      buffer.resize(msg.ByteSizeLong());
+      msg.SerializeWithCachedSizesToArray(reinterpret_cast<uint8_t*>(buffer.data()));
+      return buffer.size();
+    }
+    std::string fresh;
+    msg.SerializeToString(&fresh);
+    return fresh.size();
+  });
+
+  timing::Request out;
+  row.de = measure([&]() {
+    if (reuse) {
+      out.ParseFromArray(buffer.data(), buffer.size());
+      return out.source().size();
+    }
+    timing::Request fresh;
+    fresh.ParseFromArray(buffer.data(), buffer.size());
+    return fresh.source().size();
+  });
+  return row;
+}
+
+// thrift, with the given protocol over a TMemoryBuffer.
+template <typename Protocol>
+Row bench_thrift(const std::string& format, const std::string& payload, bool reuse) {
+  using apache::thrift::transport::TMemoryBuffer;
+  timing msg;
+  msg.__set_msgid(1);
+  msg.__set_nanosec(1);
+  msg.__set_source(payload);
+
+  auto out_buffer = std::make_shared<TMemoryBuffer>();
+  Protocol out_protocol(out_buffer);
+  msg.write(&out_protocol);
+  std::string bytes = out_buffer->getBufferAsString();
+
+  Row row{format, reuse, payload.size(), bytes.size(), {}, {}};
+  row.ser = measure([&]() {
+    if (reuse) {
+      out_buffer->resetBuffer();
+      msg.write(&out_protocol);
+      return static_cast<size_t>(out_buffer->available_read());
+    }
+    auto fresh = std::make_shared<TMemoryBuffer>();
+    Protocol protocol(fresh);
+    msg.write(&protocol);
+    return static_cast<size_t>(fresh->available_read());
+  });
+
+  uint8_t* data = reinterpret_cast<uint8_t*>(bytes.data());
+  uint32_t size = static_cast<uint32_t>(bytes.size());
+  auto in_buffer = std::make_shared<TMemoryBuffer>(data, size);
+  Protocol in_protocol(in_buffer);
+  timing out;
+  row.de = measure([&]() {
+    if (reuse) {
+      in_buffer->resetBuffer(data, size);
+      out.read(&in_protocol);
+      return out.source.size();
+    }
+    auto fresh_buffer = std::make_shared<TMemoryBuffer>(data, size);
+    Protocol protocol(fresh_buffer);
+    timing fresh;
+    fresh.read(&protocol);
+    return fresh.source.size();
+  });
+  return row;
+}
+
+int main() {
+  std::cout << "Serialization cost of the Timing message, averaged over at least "
+            << std::chrono::milliseconds(kMinRunTime).count() << "ms per case.\n"
+            << "'fresh' allocates new buffers and messages for every operation, "
+            << "'reuse' keeps them across operations.\n\n";
+  print_header();
+  for (size_t payload_size : kPayloadSizes) {
+    std::string payload(payload_size, 'x');
+    for (bool reuse : {false, true}) {
+      print_row(bench_cdr(payload, reuse));
+      print_row(bench_protobuf(payload, reuse));
+      print_row(bench_thrift<apache::thrift::protocol::TBinaryProtocol>("thrift binary", payload,
+                                                                        reuse));
+      print_row(bench_thrift<apache::thrift::protocol::TCompactProtocol>("thrift compact",
+                                                                         payload, reuse));
+    }
+    std::cout << "\n";
+  }
+  return 0;
+}
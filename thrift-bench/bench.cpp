@@ -6,32 +6,217 @@
 #include <thrift/transport/TServerSocket.h>
 #include <thrift/transport/TSocket.h>
 #include <thrift/transport/TTransportUtils.h>
+#include <thrift/transport/TVirtualTransport.h>
 
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <iostream>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <regex>
+#include <stdexcept>
+#include <string>
 #include <thread>
-#include <unordered_set>
+#include <vector>
+
+#include "benchcore/bulk.hpp"
+#include "benchcore/chain.hpp"
+#include "benchcore/flags.hpp"
+#include "benchcore/sweep.hpp"
+#include "benchcore/uring.hpp"
 
 using namespace std::chrono_literals;
-constexpr int kRelayPortStart = 5000;
-constexpr int kNumRelays = 20;
+using apache::thrift::transport::TTransportException;
+using benchcore::kRelayPortStart;
+
+// With --bulk-isolation=isolated, bulk hop i is served as hop i +
+// kBulkHopOffset, by its own server on its own connections.
+constexpr int kBulkHopOffset = 20000;
+
+// How the hops talk: --transport=socket, the default, is thrift's blocking
+// TSocket with TBufferedTransport and TSimpleServer. --transport=uring is
+// UringTransport and UringServer, see benchcore/uring.hpp for its flags.
+// The bulk chain, see benchcore/bulk.hpp, shares the servers and connections
+// unless it's isolated.
+struct ThriftOptions {
+  bool uring = false;
+  benchcore::UringOptions uring_options;
+  benchcore::BulkConfig bulk;
+
+  static ThriftOptions from_flags(const benchcore::Flags& flags) {
+    ThriftOptions options;
+    std::string transport = flags.get("transport", "socket");
+    if (transport == "uring") {
+      options.uring = true;
+    } else if (transport != "socket") {
+      throw std::invalid_argument("unknown transport: " + transport);
+    }
+    options.uring_options = benchcore::UringOptions::from_flags(flags);
+    options.bulk = benchcore::BulkConfig::from_flags(flags);
+    return options;
+  }
+};
+
+// A connection over io_uring, in place of TSocket and TBufferedTransport.
+// It buffers like TBufferedTransport, in buffers registered with its own
+// ring, so a call is usually one fixed write and one fixed read. If the
+// kernel won't register them, it reads and writes the plain buffers instead.
+// Each mode is printed the first time a connection uses it.
+class UringTransport : public apache::thrift::transport::TVirtualTransport<UringTransport> {
+ public:
+  static constexpr uint32_t kBufferSize = 64 * 1024;
+
+  // A connection to `port` that open() connects, or with fd >= 0 one a
+  // server accepted.
+  UringTransport(const benchcore::UringOptions& options, int port, int fd = -1)
+      : port_(port),
+        fd_(fd),
+        ring_(options),
+        rbuf_(new uint8_t[kBufferSize]),
+        wbuf_(new uint8_t[kBufferSize]) {
+    iovec buffers[] = {{rbuf_.get(), kBufferSize}, {wbuf_.get(), kBufferSize}};
+    int error = ring_.register_buffers(buffers, 2);
+    fixed_ = error == 0;
+    static std::once_flag fixed_once;
+    static std::once_flag plain_once;
+    std::call_once(fixed_ ? fixed_once : plain_once, [error]() {
+      if (error == 0) {
+        std::cout << "io_uring: fixed buffers\n";
+      } else {
+        std::cout << "io_uring: plain buffers, registering failed: " << strerror(-error)
+                  << "\n";
+      }
+    });
+    if (fd_ >= 0) {
+      set_nodelay();
+    }
+  }
+  ~UringTransport() override { close(); }
+
+  bool isOpen() const override { return fd_ >= 0; }
+  void open() override {
+    fd_ = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd_ < 0) {
+      throw TTransportException(TTransportException::NOT_OPEN, "socket() failed", errno);
+    }
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port_);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+      int error = errno;
+      close();
+      throw TTransportException(TTransportException::NOT_OPEN, "connect() failed", error);
+    }
+    set_nodelay();
+  }
+  void close() override {
+    if (fd_ >= 0) {
+      ::close(fd_);
+      fd_ = -1;
+    }
+  }
+
+  uint32_t read(uint8_t* buf, uint32_t len) {
+    if (rpos_ == rend_) {
+      int n = ring_.read(fd_, rbuf_.get(), kBufferSize, fixed_ ? 0 : -1);
+      if (n < 0) {
+        throw TTransportException(TTransportException::UNKNOWN, "io_uring read failed", -n);
+      }
+      rpos_ = 0;
+      rend_ = n;
+    }
+    uint32_t size = std::min(len, rend_ - rpos_);
+    memcpy(buf, rbuf_.get() + rpos_, size);
+    rpos_ += size;
+    return size;
+  }
+  void write(const uint8_t* buf, uint32_t len) {
+    while (len > 0) {
+      if (wlen_ == kBufferSize) {
+        flush();
+      }
+      uint32_t size = std::min(len, kBufferSize - wlen_);
+      memcpy(wbuf_.get() + wlen_, buf, size);
+      wlen_ += size;
+      buf += size;
+      len -= size;
+    }
+  }
+  void flush() override {
+    for (uint32_t done = 0; done < wlen_;) {
+      int n = ring_.write(fd_, wbuf_.get() + done, wlen_ - done, fixed_ ? 1 : -1);
+      if (n < 0) {
+        throw TTransportException(TTransportException::UNKNOWN, "io_uring write failed", -n);
+      }
+      done += n;
+    }
+    wlen_ = 0;
+  }
+
+ private:
+  void set_nodelay() {
+    int one = 1;
+    setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  }
+
+  int port_;
+  int fd_;
+  benchcore::Uring ring_;
+  bool fixed_ = false;
+  std::unique_ptr<uint8_t[]> rbuf_;
+  std::unique_ptr<uint8_t[]> wbuf_;
+  uint32_t rpos_ = 0;
+  uint32_t rend_ = 0;
+  uint32_t wlen_ = 0;
+};
 
 // The client we use send requests to the server.
 class RelayClient {
  public:
-  RelayClient(int id)
+  RelayClient(int id, const ThriftOptions& options)
       : port_(id + kRelayPortStart),
-        socket_(new apache::thrift::transport::TSocket("localhost", port_)),
-        transport_(new apache::thrift::transport::TBufferedTransport(socket_)),
+        transport_(make_transport(port_, options)),
         protocol_(new apache::thrift::protocol::TBinaryProtocol(transport_)),
         client_(protocol_) {}
-  void prepare() { transport_->open(); }
+  // Connects to the server. With retry_for set, keeps retrying for that long
+  // while the server, e.g. in another process, is not listening yet.
+  void prepare(std::chrono::milliseconds retry_for = 0ms) {
+    auto deadline = std::chrono::steady_clock::now() + retry_for;
+    while (true) {
+      try {
+        transport_->open();
+        return;
+      } catch (const apache::thrift::transport::TTransportException&) {
+        if (std::chrono::steady_clock::now() >= deadline) {
+          throw;
+        }
+        std::this_thread::sleep_for(50ms);
+      }
+    }
+  }
   int64_t bench(const timing& msg) { return client_.bench(msg); }
+  int64_t bench_batch(const std::vector<timing>& batch) { return client_.bench_batch(batch); }
 
  private:
+  static std::shared_ptr<apache::thrift::transport::TTransport> make_transport(
+      int port, const ThriftOptions& options) {
+    if (options.uring) {
+      return std::make_shared<UringTransport>(options.uring_options, port);
+    }
+    return std::make_shared<apache::thrift::transport::TBufferedTransport>(
+        std::make_shared<apache::thrift::transport::TSocket>("localhost", port));
+  }
+
   int port_;
-  std::shared_ptr<apache::thrift::transport::TSocket> socket_;
-  std::shared_ptr<apache::thrift::transport::TBufferedTransport> transport_;
+  std::shared_ptr<apache::thrift::transport::TTransport> transport_;
   std::shared_ptr<apache::thrift::protocol::TBinaryProtocol> protocol_;
   BenchClient client_;
 };
@@ -40,56 +225,65 @@ class RelayClient {
 // a request to the next relay.
 class RelayHandler : virtual public BenchIf {
  public:
-  RelayHandler(int id) : id_(id), client_(id + 1) {}
-  void prepare() { client_.prepare(); }
+  RelayHandler(int id, const ThriftOptions& options) : id_(id), client_(id + 1, options) {}
+  void prepare(std::chrono::milliseconds retry_for = 0ms) { client_.prepare(retry_for); }
   int64_t bench(const timing& arg) {
     timing copy;
     copy.msgid = arg.msgid;
     copy.nanosec = arg.nanosec;
-    copy.source = "relay " + std::to_string(id_);
+    copy.source = benchcore::is_bulk(arg.msgid) ? arg.source : "relay " + std::to_string(id_);
     return client_.bench(copy);
   }
+  // Forwards a batch as it came. The calls are synchronous, so there's
+  // nothing else to coalesce it with.
+  int64_t bench_batch(const std::vector<timing>& batch) {
+    std::vector<timing> copy = batch;
+    for (timing& msg : copy) {
+      msg.source = "relay " + std::to_string(id_);
+    }
+    return client_.bench_batch(copy);
+  }
 
  private:
   int id_;
   RelayClient client_;
 };
 
-// Sink server handler. This is the last hop. After it gets a request,
-// it calculates the per-hop latency.
+// Sink server handler. This is the last hop. After it gets a request, it
+// passes the message to the recorder, which calculates the per-hop latency.
 class SinkHandler : virtual public BenchIf {
  public:
+  SinkHandler(benchcore::LatencyRecorder* recorder) : recorder_(recorder) {}
   int64_t bench(const timing& arg) {
-    int64_t nanosec = std::chrono::duration_cast<std::chrono::nanoseconds>(
-                          std::chrono::steady_clock::now().time_since_epoch())
-                          .count();
-    int64_t nanosec_per_hop = (nanosec - arg.nanosec) / (kNumRelays + 1);
-    data_.insert(nanosec_per_hop);
-    std::cout << "nano seconds per hop: " << nanosec_per_hop << "\n";
-
-    if (data_.size() >= 1000) {
-      print_stats();
-      exit(0);
+    if (benchcore::is_bulk(arg.msgid)) {
+      recorder_->record_bulk(arg.nanosec);
+      return arg.msgid;
     }
+    int64_t nanosec = recorder_->arrived(1);
+    recorder_->record(arg.msgid, arg.nanosec, nanosec);
     return arg.msgid;
   }
+  int64_t bench_batch(const std::vector<timing>& batch) {
+    int64_t nanosec = recorder_->arrived(batch.size());
+    for (const timing& msg : batch) {
+      recorder_->record(msg.msgid, msg.nanosec, nanosec);
+    }
+    return batch.size();
+  }
 
  private:
-  void print_stats() {
-    std::vector<int64_t> array(data_.cbegin(), data_.cend());
-    std::sort(array.begin(), array.end());
-    int p50_index = array.size() / 2;
-    int p90_index = array.size() * 9 / 10;
-    std::cout << "\nStats with " << array.size() << " data points, ns/hop:"
-              << "\nP50 = " << array[p50_index] / 1000 << "us, P90 = " << array[p90_index] / 1000
-              << "us\n\n";
-  }
+  benchcore::LatencyRecorder* recorder_;
+};
 
-  std::unordered_multiset<int64_t> data_;
+// A hop's server, running its handling loop on a thread.
+class Server {
+ public:
+  virtual ~Server() = default;
+  virtual void wait() = 0;
 };
 
 // The server that runs the handling loop.
-class BenchServer {
+class BenchServer : public Server {
  public:
   BenchServer(int id, std::shared_ptr<BenchIf> handler)
       : port_(id + kRelayPortStart),
@@ -101,6 +295,7 @@ class BenchServer {
         server_(processor_, server_tx_, txf_, pf_) {
     thread_ = std::make_unique<std::thread>([this]() { server_.serve(); });
   }
+  void wait() override { thread_->join(); }
 
  private:
   int port_;
@@ -113,36 +308,226 @@ class BenchServer {
   std::unique_ptr<std::thread> thread_;
 };
 
-int main() {
-  // Create the relay and sink services.
-  std::vector<std::shared_ptr<RelayHandler>> handlers;
-  std::vector<std::unique_ptr<BenchServer>> relays;
-  for (int i = 0; i < kNumRelays; ++i) {
-    handlers.emplace_back(std::make_shared<RelayHandler>(i));
-    relays.emplace_back(std::make_unique<BenchServer>(i, handlers[i]));
-  }
-  BenchServer sink(kNumRelays, std::make_shared<SinkHandler>());
-  // Give them a second to initialize so not to interfere with benchmark run.
-  std::this_thread::sleep_for(1s);
-  for (int i = 0; i < kNumRelays; ++i) {
-    handlers[i]->prepare();
-  }
-  std::this_thread::sleep_for(1s);
-  std::cout << "Services initialized.\n";
-
-  // Create the client and send requests.
-  RelayClient client(0);
-  client.prepare();
-  for (int i = 0; i < 1000; ++i) {
+// TSimpleServer over io_uring: accepts with the ring and serves one
+// UringTransport connection at a time. Listens from construction on, and
+// throws from there if it can't set up the ring or the socket.
+class UringServer : public Server {
+ public:
+  UringServer(int id, std::shared_ptr<BenchIf> handler, const benchcore::UringOptions& options)
+      : port_(id + kRelayPortStart),
+        options_(options),
+        processor_(new BenchProcessor(handler)),
+        ring_(options),
+        listen_fd_(socket(AF_INET, SOCK_STREAM, 0)) {
+    if (listen_fd_ < 0) {
+      throw TTransportException(TTransportException::NOT_OPEN, "socket() failed", errno);
+    }
+    int one = 1;
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port_);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        listen(listen_fd_, 16) != 0) {
+      int error = errno;
+      close(listen_fd_);
+      throw TTransportException(TTransportException::NOT_OPEN,
+                                "can't listen on port " + std::to_string(port_), error);
+    }
+    thread_ = std::make_unique<std::thread>([this]() { serve(); });
+  }
+  void wait() override { thread_->join(); }
+
+ private:
+  void serve() {
+    while (true) {
+      int fd = ring_.accept(listen_fd_);
+      // A connection reset before it was accepted, or a signal, leaves the
+      // listening socket as it was. Anything else won't go away on retry.
+      if (fd == -EINTR || fd == -ECONNABORTED) {
+        continue;
+      }
+      if (fd < 0) {
+        std::cerr << "io_uring accept on port " << port_ << " failed: " << strerror(-fd)
+                  << "\n";
+        return;
+      }
+      auto transport = std::make_shared<UringTransport>(options_, port_, fd);
+      auto protocol = std::make_shared<apache::thrift::protocol::TBinaryProtocol>(transport);
+      try {
+        while (processor_->process(protocol, protocol, nullptr)) {
+        }
+      } catch (const TTransportException&) {
+        // The client disconnected.
+      }
+    }
+  }
+
+  int port_;
+  benchcore::UringOptions options_;
+  std::shared_ptr<BenchProcessor> processor_;
+  // Only used by the server thread after construction.
+  benchcore::Uring ring_;
+  int listen_fd_;
+  std::unique_ptr<std::thread> thread_;
+};
+
+// The chain over thrift, one server per hop. A TSimpleServer serves one
+// connection at a time, so a shared bulk chain takes turns with the measured
+// one on the same connections, and an isolated one has its own servers.
+class ThriftTransport : public benchcore::ChainTransport {
+ public:
+  explicit ThriftTransport(const ThriftOptions& options) : options_(options) {}
+
+  void start_relay(int hop) override {
+    start_relay_server(hop);
+    if (isolated_bulk()) {
+      start_relay_server(hop + kBulkHopOffset);
+    }
+  }
+  void connect_relay(int hop, std::chrono::milliseconds retry_for) override {
+    std::vector<std::shared_ptr<RelayHandler>> handlers;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      handlers.push_back(handlers_.at(hop));
+      if (isolated_bulk()) {
+        handlers.push_back(handlers_.at(hop + kBulkHopOffset));
+      }
+    }
+    for (auto& handler : handlers) {
+      handler->prepare(retry_for);
+    }
+  }
+  void start_sink(int hop, benchcore::LatencyRecorder* recorder) override {
+    auto handler = std::make_shared<SinkHandler>(recorder);
+    std::lock_guard<std::mutex> lock(mutex_);
+    servers_.push_back(make_server(hop, handler));
+    if (isolated_bulk()) {
+      servers_.push_back(make_server(hop + kBulkHopOffset, handler));
+    }
+  }
+  void connect_source(std::chrono::milliseconds retry_for) override {
+    client_ = std::make_unique<RelayClient>(0, options_);
+    client_->prepare(retry_for);
+  }
+  void connect_bulk_source(std::chrono::milliseconds retry_for) override {
+    if (isolated_bulk()) {
+      bulk_client_ = std::make_unique<RelayClient>(kBulkHopOffset, options_);
+      bulk_client_->prepare(retry_for);
+    }
+  }
+  void send(std::vector<benchcore::ChainMessage> messages) override {
+    std::unique_lock<std::mutex> lock(client_mutex_, std::defer_lock);
+    if (options_.bulk.enabled() && !isolated_bulk()) {
+      lock.lock();
+    }
+    if (messages.size() == 1) {
+      client_->bench(to_timing(messages[0]));
+      return;
+    }
+    std::vector<timing> batch;
+    batch.reserve(messages.size());
+    for (benchcore::ChainMessage& message : messages) {
+      batch.push_back(to_timing(message));
+    }
+    client_->bench_batch(batch);
+  }
+  void send_bulk(benchcore::ChainMessage message) override {
+    if (bulk_client_) {
+      bulk_client_->bench(to_timing(message));
+      return;
+    }
+    std::lock_guard<std::mutex> lock(client_mutex_);
+    client_->bench(to_timing(message));
+  }
+  void wait() override {
+    for (auto& server : servers_) {
+      server->wait();
+    }
+  }
+
+ private:
+  bool isolated_bulk() const { return options_.bulk.enabled() && options_.bulk.isolated; }
+
+  void start_relay_server(int hop) {
+    auto handler = std::make_shared<RelayHandler>(hop, options_);
+    std::unique_ptr<Server> server = make_server(hop, handler);
+    std::lock_guard<std::mutex> lock(mutex_);
+    handlers_[hop] = handler;
+    servers_.push_back(std::move(server));
+  }
+
+  std::unique_ptr<Server> make_server(int hop, std::shared_ptr<BenchIf> handler) {
+    if (options_.uring) {
+      return std::make_unique<UringServer>(hop, handler, options_.uring_options);
+    }
+    return std::make_unique<BenchServer>(hop, handler);
+  }
+
+  static timing to_timing(benchcore::ChainMessage& message) {
     timing msg;
-    msg.msgid = 0;
-    msg.source = "client";
-    msg.nanosec = std::chrono::duration_cast<std::chrono::nanoseconds>(
-                      std::chrono::steady_clock::now().time_since_epoch())
-                      .count();
-    int64_t ack = client.bench(msg);
-    std::this_thread::sleep_for(100ms);
-  }
-  std::this_thread::sleep_for(100s);
+    msg.msgid = message.msgid;
+    msg.nanosec = message.nanosec;
+    msg.source = std::move(message.source);
+    return msg;
+  }
+
+  ThriftOptions options_;
+  std::mutex mutex_;
+  std::map<int, std::shared_ptr<RelayHandler>> handlers_;
+  std::vector<std::unique_ptr<Server>> servers_;
+  // With a shared bulk chain, the source and the bulk source take turns on
+  // client_.
+  std::mutex client_mutex_;
+  std::unique_ptr<RelayClient> client_;
+  std::unique_ptr<RelayClient> bulk_client_;
+};
+
+// With --transport-sweep, runs this binary over the blocking sockets, over
+// io_uring, and over io_uring with SQPOLL, at each of --sweep-rates (default
+// 10,100,1000) Hz, and prints the per-hop latency and the io_uring buffers of
+// each as a table. --transport-sweep=socket,uring picks a subset. Other flags
+// are passed on to every run.
+int run_transport_sweep(const benchcore::Flags& flags) {
+  std::string requested = flags.get("transport-sweep");
+  std::vector<std::string> transports =
+      benchcore::split(requested == "true" ? "socket,uring,uring-sqpoll" : requested);
+  std::vector<std::string> rates = benchcore::split(flags.get("sweep-rates", "10,100,1000"));
+  std::vector<benchcore::SweepCase> cases;
+  std::vector<std::vector<std::string>> rows;
+  for (const std::string& rate : rates) {
+    for (const std::string& transport : transports) {
+      benchcore::SweepCase sweep_case{transport + " at " + rate + "Hz", {"--rate-hz=" + rate}};
+      if (transport == "uring-sqpoll") {
+        sweep_case.args.insert(sweep_case.args.end(), {"--transport=uring", "--uring-sqpoll"});
+      } else {
+        sweep_case.args.push_back("--transport=" + transport);
+      }
+      cases.push_back(std::move(sweep_case));
+      rows.push_back({rate, transport});
+    }
+  }
+  std::vector<benchcore::SweepRun> runs = benchcore::run_sweep(
+      flags, {"--transport", "--uring-sqpoll", "--rate-hz"}, cases, std::chrono::seconds(300));
+
+  static const std::regex buffers_re("io_uring: (\\w+) buffers");
+  for (size_t i = 0; i < runs.size(); ++i) {
+    rows[i].insert(rows[i].end(), {runs[i].stats.p50_cell(), runs[i].stats.p90_cell(),
+                                   benchcore::find_in_output(runs[i].process, buffers_re)});
+  }
+  benchcore::print_sweep_table(
+      std::cout, "Transport sweep, latency in us/hop:",
+      {"Rate (Hz)", "Transport", "P50 (us/hop)", "P90 (us/hop)", "io_uring buffers"}, rows);
   return 0;
-}
\ No newline at end of file
+}
+
+// See benchcore::run_chain() for the flags.
+int main(int argc, char* argv[]) {
+  benchcore::Flags flags(argc, argv);
+  if (flags.has("transport-sweep")) {
+    return run_transport_sweep(flags);
+  }
+  ThriftTransport transport(ThriftOptions::from_flags(flags));
+  return benchcore::run_chain(flags, transport);
+}
@@ -1,40 +0,0 @@
-// This autogenerated skeleton file illustrates how to build a server.
-// You should copy it to another filename to avoid overwriting it.
-
-#include "Bench.h"
-#include <thrift/protocol/TBinaryProtocol.h>
-#include <thrift/server/TSimpleServer.h>
-#include <thrift/transport/TServerSocket.h>
-#include <thrift/transport/TBufferTransports.h>
-
-using namespace ::apache::thrift;
-using namespace ::apache::thrift::protocol;
-using namespace ::apache::thrift::transport;
-using namespace ::apache::thrift::server;
-
-class BenchHandler : virtual public BenchIf {
- public:
-  BenchHandler() {
-    // Your initialization goes here
-  }
-
-  int64_t bench(const timing& arg) {
-    // Your implementation goes here
-    printf("bench\n");
-  }
-
-};
-
-int main(int argc, char **argv) {
-  int port = 9090;
-  ::std::shared_ptr<BenchHandler> handler(new BenchHandler());
-  ::std::shared_ptr<TProcessor> processor(new BenchProcessor(handler));
-  ::std::shared_ptr<TServerTransport> serverTransport(new TServerSocket(port));
-  ::std::shared_ptr<TTransportFactory> transportFactory(new TBufferedTransportFactory());
-  ::std::shared_ptr<TProtocolFactory> protocolFactory(new TBinaryProtocolFactory());
-
-  TSimpleServer server(processor, serverTransport, transportFactory, protocolFactory);
-  server.serve();
-  return 0;
-}
-
@@ -6,4 +6,5 @@ struct timing {
 
 service Bench {
 	i64 bench(1:timing arg)
+	i64 bench_batch(1:list<timing> batch)
 }
\ No newline at end of file
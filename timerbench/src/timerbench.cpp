@@ -0,0 +1,173 @@
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchcore/flags.hpp"
+#include "benchcore/jitter.hpp"
+#include "rclcpp/rclcpp.hpp"
+
+using benchcore::LatenessHistogram;
+using benchcore::PeriodicLateness;
+
+int64_t steady_ns() { return PeriodicLateness::steady_ns(); }
+
+// An rclcpp wall timer on a single-threaded executor, like the pnode
+// source's.
+void run_wall_timer(std::chrono::nanoseconds period, int64_t samples, LatenessHistogram* out) {
+  auto node = std::make_shared<rclcpp::Node>("timerbench");
+  rclcpp::executors::SingleThreadedExecutor executor;
+  PeriodicLateness lateness(period, out);
+  rclcpp::TimerBase::SharedPtr timer;
+  timer = node->create_wall_timer(period, [&]() {
+    lateness.tick();
+    if (static_cast<int64_t>(out->size()) >= samples) {
+      timer->cancel();
+      executor.cancel();
+    }
+  });
+  executor.add_node(node);
+  executor.spin();
+}
+
+// sleep_for(period) after each run. The schedule drifts by the lateness, so
+// the lateness is measured from the end of each sleep's requested period.
+void run_sleep_for(std::chrono::nanoseconds period, int64_t samples, LatenessHistogram* out) {
+  for (int64_t i = 0; i < samples; ++i) {
+    int64_t before = steady_ns();
+    std::this_thread::sleep_for(period);
+    out->add(steady_ns() - before - period.count());
+  }
+}
+
+// Calls wait(deadline) for absolute deadlines start + n * period, skipping
+// the ones already passed after a late wakeup.
+void run_absolute(std::chrono::nanoseconds period, int64_t samples, LatenessHistogram* out,
+                  const std::function<void(int64_t)>& wait) {
+  int64_t deadline = steady_ns();
+  for (int64_t i = 0; i < samples; ++i) {
+    deadline += period.count();
+    wait(deadline);
+    int64_t now = steady_ns();
+    out->add(now - deadline);
+    if (now - deadline >= period.count()) {
+      int64_t missed = (now - deadline) / period.count();
+      out->add_missed(missed);
+      deadline += missed * period.count();
+    }
+  }
+}
+
+void run_sleep_until(std::chrono::nanoseconds period, int64_t samples, LatenessHistogram* out) {
+  run_absolute(period, samples, out, [](int64_t deadline) {
+    std::this_thread::sleep_until(
+        std::chrono::steady_clock::time_point(std::chrono::nanoseconds(deadline)));
+  });
+}
+
+// steady_clock is CLOCK_MONOTONIC on Linux, so the deadlines carry over.
+void run_nanosleep(std::chrono::nanoseconds period, int64_t samples, LatenessHistogram* out) {
+  run_absolute(period, samples, out, [](int64_t deadline) {
+    timespec ts{static_cast<time_t>(deadline / 1000000000), static_cast<long>(deadline % 1000000000)};
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {
+    }
+  });
+}
+
+// A periodic CLOCK_MONOTONIC timerfd. Each read returns the number of
+// expirations since the last one, more than one after a late wakeup.
+void run_timerfd(std::chrono::nanoseconds period, int64_t samples, LatenessHistogram* out) {
+  int fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+  if (fd < 0) {
+    perror("timerfd_create");
+    return;
+  }
+  int64_t start = steady_ns();
+  auto to_timespec = [](int64_t ns) {
+    return timespec{static_cast<time_t>(ns / 1000000000), static_cast<long>(ns % 1000000000)};
+  };
+  itimerspec spec{to_timespec(period.count()), to_timespec(start + period.count())};
+  timerfd_settime(fd, TFD_TIMER_ABSTIME, &spec, nullptr);
+  int64_t expirations = 0;
+  for (int64_t i = 0; i < samples; ++i) {
+    uint64_t count = 0;
+    if (read(fd, &count, sizeof(count)) != sizeof(count)) {
+      perror("read timerfd");
+      break;
+    }
+    // The lateness of the first expiration, the one this read was due for,
+    // the later ones were missed.
+    out->add(steady_ns() - (start + (expirations + 1) * period.count()));
+    out->add_missed(count - 1);
+    expirations += count;
+  }
+  close(fd);
+}
+
+using TimerRun = void (*)(std::chrono::nanoseconds, int64_t, LatenessHistogram*);
+
+const std::map<std::string, std::pair<std::string, TimerRun>> kTimers = {
+    {"wall", {"rclcpp wall timer", run_wall_timer}},
+    {"sleep_for", {"sleep_for", run_sleep_for}},
+    {"sleep_until", {"sleep_until", run_sleep_until}},
+    {"nanosleep", {"clock_nanosleep absolute", run_nanosleep}},
+    {"timerfd", {"timerfd", run_timerfd}},
+};
+
+// Measures how late periodic callbacks run for each kind of timer and rate,
+// and prints a lateness histogram per case and a summary table.
+//   --timers=wall,sleep_for,sleep_until,nanosleep,timerfd
+//   --rates-hz=10,100,1000,10000
+//   --seconds=5    run time per case, at least 10 samples
+int main(int argc, char* argv[]) {
+  rclcpp::init(argc, argv);
+  benchcore::Flags flags(rclcpp::remove_ros_arguments(argc, argv));
+  std::vector<std::string> timers =
+      benchcore::split(flags.get("timers", "wall,sleep_for,sleep_until,nanosleep,timerfd"));
+  std::vector<std::string> rates = benchcore::split(flags.get("rates-hz", "10,100,1000,10000"));
+  double seconds = flags.get_double("seconds", 5);
+
+  std::vector<std::string> rows;
+  for (const std::string& timer : timers) {
+    auto it = kTimers.find(timer);
+    if (it == kTimers.end()) {
+      std::cerr << "Unknown timer " << timer << "\n";
+      return 1;
+    }
+    const auto& [name, run] = it->second;
+    std::string row = "| " + name + " |";
+    for (const std::string& rate : rates) {
+      double hz = std::stod(rate);
+      auto period = std::chrono::nanoseconds(static_cast<int64_t>(1e9 / hz));
+      int64_t samples = std::max<int64_t>(10, static_cast<int64_t>(hz * seconds));
+      LatenessHistogram histogram(name + " at " + rate + "Hz");
+      run(period, samples, &histogram);
+      histogram.print(std::cout);
+      row += " " + histogram.summary() + " |";
+    }
+    rows.push_back(row);
+  }
+
+  std::cout << "Timer lateness P50/P99/max in us:\n| Timer |";
+  for (const std::string& rate : rates) {
+    std::cout << " " << rate << "Hz |";
+  }
+  std::cout << "\n| --- |";
+  for (size_t i = 0; i < rates.size(); ++i) {
+    std::cout << " --- |";
+  }
+  std::cout << "\n";
+  for (const std::string& row : rows) {
+    std::cout << row << "\n";
+  }
+  rclcpp::shutdown();
+  return 0;
+}
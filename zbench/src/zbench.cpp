@@ -0,0 +1,241 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "benchcore/chain.hpp"
+#include "benchcore/clock.hpp"
+#include "benchcore/flags.hpp"
+#include "benchcore/idle.hpp"
+#include "benchcore/memory.hpp"
+#include "benchcore/report.hpp"
+#include "benchcore/soak.hpp"
+#include "benchcore/traffic.hpp"
+#include "benchcore/warmup.hpp"
+#include "zenoh.hxx"
+
+using namespace std::chrono_literals;
+using benchcore::kNumRelays;
+constexpr int kNumMessages = benchcore::kNumSamples;
+constexpr int kZenohPortStart = 7447;
+
+// Shared memory needs zenoh-c built with the shared-memory and unstable-api
+// features.
+#if defined(Z_FEATURE_SHARED_MEMORY) && defined(Z_FEATURE_UNSTABLE_API)
+#define ZBENCH_SHM 1
+using ShmProvider = zenoh::PosixShmProvider;
+#else
+struct ShmProvider {};
+#endif
+
+// The same fields as pnodeif/msg/Timing.msg.
+struct Timing {
+  int64_t msgid;
+  int64_t nanosec;
+  std::string source;
+};
+
+// Wire layout of a Timing: this header, followed by the source bytes.
+struct TimingHeader {
+  int64_t msgid;
+  int64_t nanosec;
+  uint64_t source_size;
+};
+
+size_t encoded_size(const Timing& t) { return sizeof(TimingHeader) + t.source.size(); }
+
+void encode(const Timing& t, uint8_t* out) {
+  TimingHeader header{t.msgid, t.nanosec, t.source.size()};
+  memcpy(out, &header, sizeof(header));
+  memcpy(out + sizeof(header), t.source.data(), t.source.size());
+}
+
+Timing decode(const zenoh::Bytes& payload) {
+  std::vector<uint8_t> data = payload.as_vector();
+  TimingHeader header;
+  memcpy(&header, data.data(), sizeof(header));
+  return Timing{header.msgid, header.nanosec,
+                std::string(reinterpret_cast<const char*>(data.data()) + sizeof(header),
+                            header.source_size)};
+}
+
+// Opens a peer session on localhost. With separate sessions per node, node i
+// listens on kZenohPortStart + i and connects to the previous node, so every
+// message goes through the zenoh transport like between ROS 2 processes.
+// A single session delivers locally, like the Rust zenohbench.
+zenoh::Session open_session(int node, bool separate, bool shm) {
+  zenoh::Config config = zenoh::Config::create_default();
+  config.insert_json5("mode", "\"peer\"");
+  config.insert_json5("scouting/multicast/enabled", "false");
+  if (separate) {
+    config.insert_json5("listen/endpoints",
+                        "[\"tcp/127.0.0.1:" + std::to_string(kZenohPortStart + node) + "\"]");
+    if (node > 0) {
+      config.insert_json5(
+          "connect/endpoints",
+          "[\"tcp/127.0.0.1:" + std::to_string(kZenohPortStart + node - 1) + "\"]");
+    }
+  }
+  config.insert_json5("transport/shared_memory/enabled", shm ? "true" : "false");
+  return zenoh::Session::open(std::move(config));
+}
+
+// Publishes Timing messages. They are serialized into a heap buffer, or with
+// a shared memory provider, into a buffer allocated from it, which
+// subscribers in other sessions on the same host map instead of copying.
+class TimingPublisher {
+ public:
+  TimingPublisher(zenoh::Session& session, const std::string& key, ShmProvider* shm_provider)
+      : publisher_(session.declare_publisher(zenoh::KeyExpr(key))), shm_provider_(shm_provider) {}
+
+  void publish(const Timing& t) {
+#ifdef ZBENCH_SHM
+    if (shm_provider_) {
+      auto result =
+          shm_provider_->alloc_gc_defrag_blocking(encoded_size(t), zenoh::AllocAlignment({0}));
+      if (auto* buf = std::get_if<zenoh::ZShmMut>(&result)) {
+        encode(t, buf->data());
+        publisher_.put(zenoh::Bytes(std::move(*buf)));
+        return;
+      }
+      // The pool is exhausted, fall back to a heap buffer.
+    }
+#endif
+    std::vector<uint8_t> data(encoded_size(t));
+    encode(t, data.data());
+    publisher_.put(zenoh::Bytes(std::move(data)));
+  }
+
+  // Publishes an already serialized message without copying it.
+  void forward(const zenoh::Bytes& payload) { publisher_.put(payload.clone()); }
+
+ private:
+  zenoh::Publisher publisher_;
+  ShmProvider* shm_provider_;
+};
+
+// The relay to pass on messages. It deserializes and serializes every
+// message like a pnode relay, except with shared memory, where it forwards
+// the received buffer as is.
+class ZenohRelay {
+ public:
+  ZenohRelay(zenoh::Session& session, int index, ShmProvider* shm_provider)
+      : shm_(shm_provider != nullptr),
+        publisher_(session, "bench/hop" + std::to_string(index + 1), shm_provider),
+        subscriber_(session.declare_subscriber(
+            zenoh::KeyExpr("bench/hop" + std::to_string(index)),
+            [this](const zenoh::Sample& sample) { listen(sample); }, zenoh::closures::none)) {}
+
+  void listen(const zenoh::Sample& sample) {
+    if (shm_) {
+      publisher_.forward(sample.get_payload());
+      return;
+    }
+    Timing msg = decode(sample.get_payload());
+    publisher_.publish(msg);
+  }
+
+ private:
+  bool shm_;
+  TimingPublisher publisher_;
+  zenoh::Subscriber<void> subscriber_;
+};
+
+// The sink to complete the final hop, passing every message to the
+// recorder.
+class ZenohSink {
+ public:
+  ZenohSink(zenoh::Session& session, benchcore::LatencyRecorder* recorder)
+      : recorder_(recorder),
+        subscriber_(session.declare_subscriber(
+            zenoh::KeyExpr("bench/hop" + std::to_string(kNumRelays)),
+            [this](const zenoh::Sample& sample) { listen(sample); }, zenoh::closures::none)) {}
+
+  void listen(const zenoh::Sample& sample) {
+    Timing msg = decode(sample.get_payload());
+    int64_t nanosec = recorder_->arrived(1);
+    recorder_->record(msg.msgid, msg.nanosec, nanosec);
+  }
+
+ private:
+  benchcore::LatencyRecorder* recorder_;
+  zenoh::Subscriber<void> subscriber_;
+};
+
+int main(int argc, char* argv[]) {
+  benchcore::Flags flags(argc, argv);
+  benchcore::init_clock(flags);
+  // --shm publishes from a POSIX shared memory provider. It only makes a
+  // difference between sessions, so it implies --session-per-hop.
+  bool shm = flags.get_bool("shm");
+  bool separate = shm || flags.get_bool("session-per-hop");
+  std::string source = flags.has("payload-size")
+                           ? std::string(flags.get_int("payload-size", 0), 'x')
+                           : std::string("zenoh publisher");
+
+  // With --memmon, sample memory from before the sessions are opened.
+  auto memory = benchcore::MemorySampler::from_flags(flags, kNumRelays + 2, source.size());
+
+  std::unique_ptr<ShmProvider> shm_provider;
+#ifdef ZBENCH_SHM
+  if (shm) {
+    // Room for the messages in flight through the whole chain.
+    size_t pool_size =
+        std::max<size_t>(1 << 20, 4 * (kNumRelays + 1) * (sizeof(TimingHeader) + source.size()));
+    shm_provider = std::make_unique<ShmProvider>(
+        zenoh::MemoryLayout(pool_size, zenoh::AllocAlignment({2})));
+  }
+#else
+  if (shm) {
+    std::cout << "zenoh-c is built without shared memory support, --shm is ignored.\n";
+  }
+#endif
+
+  // With --session-per-hop, session i belongs to node i: the source, the
+  // relays, then the sink.
+  std::vector<zenoh::Session> sessions;
+  for (int i = 0; i <= kNumRelays + 1; ++i) {
+    if (separate || i == 0) {
+      sessions.push_back(open_session(i, separate, shm));
+    }
+  }
+  auto session = [&](int i) -> zenoh::Session& { return sessions[separate ? i : 0]; };
+
+  // The sink's stats, and with --soak-minutes, --capture=FILE or --warmup
+  // everything else it does with the messages, see benchcore/chain.hpp.
+  // msgids start at 1, one every 1ms on average.
+  benchcore::RecorderOptions recorder_options;
+  recorder_options.first_msgid = 1;
+  recorder_options.period = 1ms;
+  benchcore::LatencyRecorder recorder(flags, std::move(recorder_options));
+  ZenohSink sink(session(kNumRelays + 1), &recorder);
+  std::vector<std::unique_ptr<ZenohRelay>> relays;
+  for (int i = kNumRelays - 1; i >= 0; --i) {
+    relays.push_back(std::make_unique<ZenohRelay>(session(i + 1), i, shm_provider.get()));
+  }
+  TimingPublisher publisher(session(0), "bench/hop0", shm_provider.get());
+  // Give the sessions a second to connect and declare their interests.
+  std::this_thread::sleep_for(1s);
+  std::cout << "Sessions initialized.\n";
+  benchcore::IdleAnalysis idle_analysis(flags);
+
+  // Publish at the same 1ms period as the pnode source, spaced by --traffic,
+  // until the sink exits, or stop if it never gets all messages.
+  benchcore::Pacer pacer(flags, 1ms);
+  int64_t last_msgid = benchcore::soak_requested(flags)
+                           ? std::numeric_limits<int64_t>::max()
+                           : 10 * (kNumMessages + benchcore::Warmup::extra_messages(flags));
+  for (int64_t msgid = 1; msgid <= last_msgid; ++msgid) {
+    publisher.publish(Timing{msgid, benchcore::now_ns(), source});
+    pacer.wait();
+  }
+  std::cout << "Sink didn't receive " << kNumMessages << " messages.\n";
+  return 1;
+}